@@ -0,0 +1,95 @@
+#ifndef BLOCK_LAYOUT_HPP_INCLUDED
+#define BLOCK_LAYOUT_HPP_INCLUDED
+
+#include <cstdint>
+#include <new>
+
+#include "impl_details.hpp"
+
+namespace otf_gc
+{
+  struct small_layout
+  {
+    static inline impl_details::header_t* header(std::uint64_t p)
+    {
+      return reinterpret_cast<impl_details::header_t*>(p + impl_details::log_ptr_size);
+    }
+
+    static inline void initialize(std::uint64_t p, impl_details::underlying_header_t h, std::size_t)
+    {
+      using namespace impl_details;
+
+      new(reinterpret_cast<void*>(p)) log_ptr_t(nullptr);
+      new(header(p)) header_t(h);
+    }
+
+    static inline void destroy_metadata(std::uint64_t p)
+    {
+      using namespace impl_details;
+
+      reinterpret_cast<log_ptr_t*>(p)->~log_ptr_t();
+      header(p)->~header_t();
+    }
+  };
+
+  struct leaf_layout
+  {
+    static inline impl_details::header_t* header(std::uint64_t p)
+    {
+      return reinterpret_cast<impl_details::header_t*>(p);
+    }
+
+    static inline void initialize(std::uint64_t p, impl_details::underlying_header_t h, std::size_t)
+    {
+      new(header(p)) impl_details::header_t(h);
+    }
+
+    static inline void destroy_metadata(std::uint64_t p)
+    {
+      using namespace impl_details;
+
+      header(p)->~header_t();
+    }
+  };
+
+  struct medium_layout
+  {
+    static inline std::size_t& num_log_ptrs(std::uint64_t p)
+    {
+      return *reinterpret_cast<std::size_t*>(p);
+    }
+
+    static inline impl_details::log_ptr_t* log_ptr(std::uint64_t p, std::size_t i)
+    {
+      return reinterpret_cast<impl_details::log_ptr_t*>(p + sizeof(std::size_t) + i * impl_details::log_ptr_size);
+    }
+
+    static inline impl_details::header_t* header(std::uint64_t p)
+    {
+      return reinterpret_cast<impl_details::header_t*>(log_ptr(p, num_log_ptrs(p)));
+    }
+
+    static inline void initialize(std::uint64_t p, impl_details::underlying_header_t h, std::size_t n)
+    {
+      using namespace impl_details;
+
+      num_log_ptrs(p) = n;
+
+      for(std::size_t i = 0; i < n; ++i)
+	new(log_ptr(p, i)) log_ptr_t(nullptr);
+
+      new(header(p)) header_t(h);
+    }
+
+    static inline void destroy_metadata(std::uint64_t p)
+    {
+      using namespace impl_details;
+
+      for(std::size_t i = 0; i < num_log_ptrs(p); ++i)
+	log_ptr(p, i)->~log_ptr_t();
+
+      header(p)->~header_t();
+    }
+  };
+}
+#endif
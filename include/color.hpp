@@ -9,14 +9,15 @@ namespace otf_gc
     {
       Blue = 0x00,
       Black = 0x01,
-      White = 0x02
+      White = 0x02,
+      Grey = 0x03 // claimed by a marker tracing it segment by segment.
     };
 
     color_t c;
 
     color(int8_t h) noexcept : c(static_cast<color_t>(h))
     {
-      assert(0 <= h && h <= 2);
+      assert(0 <= h && h <= 3);
     }
     
     color(color_t c_ = color_t::Black) noexcept
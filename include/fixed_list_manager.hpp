@@ -2,6 +2,7 @@
 #define FIXED_LIST_MANAGER_HPP_INCLUDED
 
 #include <atomic>
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
 
@@ -13,20 +14,81 @@ namespace otf_gc
   class fixed_list_manager
   {
   private:
+    std::uintptr_t cursor, limit;
+
     stub* alloc;
-    size_t offset;
+    std::uintptr_t used_start;
     const size_t obj_size;
-    size_t log_multiplier;
+    size_t log_multiplier, consumed;
 
     stub_list free_list, used_list;
+
+    inline void retire_alloc()
+    {
+      assert(cursor == limit);
+
+      if(used_start == reinterpret_cast<std::uintptr_t>(alloc->start)) {
+	consumed += cursor - used_start;
+	used_list.push_back(alloc);
+      } else {
+	flush_used_span();
+	delete alloc;
+      }
+    }
+
+    inline void set_alloc(stub* st)
+    {
+      alloc = st;
+
+      if(st) {
+	cursor = used_start = reinterpret_cast<std::uintptr_t>(st->start);
+	limit = cursor + st->size;
+      } else {
+	cursor = limit = used_start = 0;
+      }
+    }
   public:
     fixed_list_manager(size_t size_)
-      : alloc{nullptr}
-      , offset{0}
+      : cursor{0}
+      , limit{0}
+      , alloc{nullptr}
+      , used_start{0}
       , obj_size{size_}
       , log_multiplier{3}
+      , consumed{0}
     {}
 
+    inline void flush_used_span()
+    {
+      if(cursor > used_start) {
+	consumed += cursor - used_start;
+	used_list.push_back(new stub(reinterpret_cast<void*>(used_start), cursor - used_start));
+	used_start = cursor;
+      }
+    }
+
+    // hands over the current allocation span: what has been bumped goes
+    // to the used list, and the unbumped tail is returned as a free stub.
+    inline stub_list release_alloc_span() {
+      stub_list result;
+
+      if(!alloc)
+	return result;
+
+      flush_used_span();
+
+      if(cursor < limit) {
+	alloc->start = reinterpret_cast<void*>(cursor);
+	alloc->size = limit - cursor;
+	result.push_front(alloc);
+      } else {
+	delete alloc;
+      }
+
+      set_alloc(nullptr);
+      return result;
+    }
+
     inline stub_list release_free_list() {
       auto result = free_list;
       free_list.reset();
@@ -34,11 +96,20 @@ namespace otf_gc
     }
 
     inline stub_list release_used_list() {
+      flush_used_span();
+
       auto result = used_list;
       used_list.reset();
       return result;
     }
 
+    // bytes bumped out of spans since retired or flushed to the used list.
+    inline size_t release_consumed_bytes() {
+      size_t result = consumed;
+      consumed = 0;
+      return result;
+    }
+
     inline void push_front(void* blk, size_t sz)
     {
       assert(blk != nullptr);
@@ -47,7 +118,7 @@ namespace otf_gc
       if(alloc)
 	free_list.push_back(st);
       else
-	alloc = st;
+	set_alloc(st);
     }
 
     inline void append(stub_list&& sl)
@@ -55,59 +126,55 @@ namespace otf_gc
       free_list.append(std::move(sl));
 
       if(!alloc) {
-	alloc = free_list.front();
+	set_alloc(free_list.front());
 	free_list.pop_front();
-      }	
+      }
+    }
+
+    OTF_GC_ALWAYS_INLINE void* bump()
+    {
+      if(OTF_GC_LIKELY(cursor < limit)) {
+	void* ptr = reinterpret_cast<void*>(cursor);
+	cursor += obj_size;
+	return ptr;
+      }
+
+      return nullptr;
     }
 
     inline void* get_block()
     {
+      if(void* ptr = bump())
+	return ptr;
+
       if(!alloc)
 	return nullptr;
 
-      assert(alloc->start != nullptr);
-
-      void* ptr = nullptr;
-      std::ptrdiff_t st = reinterpret_cast<std::ptrdiff_t>(alloc->start);
+      retire_alloc();
+      set_alloc(free_list.front());
 
-      if(offset < alloc->size) {
-	ptr = reinterpret_cast<void*>(st + offset);
-	offset += (1ULL << obj_size);
-      } else {
-	assert(offset == alloc->size);
-	alloc = free_list.front();
-
-	if(alloc) {
-	  free_list.pop_front();
-	  ptr = alloc->start;
-	  offset = (1ULL << obj_size);
-	}
-      }
+      if(!alloc)
+	return nullptr;
 
-      if(ptr)
-	used_list.push_back(new stub(ptr, 1ULL << obj_size));
+      free_list.pop_front();
 
-      return ptr;
+      return bump();
     }
 
     inline void* get_new_block()
     {
       assert(!alloc);
-      void* blk = aligned_alloc(alignof(impl_details::header_t), 1ULL << (obj_size + log_multiplier));
-      
-      push_front(blk, 1ULL << (obj_size + log_multiplier));
+      void* blk = aligned_alloc(alignof(impl_details::header_t), obj_size << log_multiplier);
 
-      if(obj_size + log_multiplier < impl_details::small_block_size_limit + obj_size)
-	++log_multiplier;
+      push_front(blk, obj_size << log_multiplier);
 
-      offset = 1ULL << obj_size;
+      if(log_multiplier < impl_details::small_block_size_limit)
+	++log_multiplier;
 
-      if(alloc->start)
-	used_list.push_back(new stub(alloc->start, 1ULL << obj_size));
+      void* ptr = bump();
+      assert(ptr == blk);
 
-      assert(alloc->start == blk);
-      
-      return blk;
+      return ptr;
     }
   };
 }
@@ -0,0 +1,44 @@
+#ifndef FREE_SPAN_LIST_HPP_INCLUDED
+#define FREE_SPAN_LIST_HPP_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+
+#include "atomic_list.hpp"
+#include "stub_list.hpp"
+
+namespace otf_gc
+{
+  // a size class's free spans, published a run at a time, along with the
+  // bytes they hold so the scavenger can size the list without walking it.
+  class free_span_list
+  {
+  private:
+    atomic_list<stub_list> runs;
+    std::atomic<std::size_t> free_bytes;
+  public:
+    free_span_list() : free_bytes(0) {}
+
+    inline void push_front(stub_list sl)
+    {
+      free_bytes.fetch_add(sl.bytes(), std::memory_order_relaxed);
+      runs.push_front(sl);
+    }
+
+    inline stub_list pop_front()
+    {
+      stub_list sl = runs.pop_front();
+
+      if(sl)
+	free_bytes.fetch_sub(sl.bytes(), std::memory_order_relaxed);
+
+      return sl;
+    }
+
+    inline std::size_t bytes() const
+    {
+      return free_bytes.load(std::memory_order_relaxed);
+    }
+  };
+}
+#endif
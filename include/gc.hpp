@@ -1,21 +1,39 @@
 #ifndef GC_HPP_INCLUDED
 #define GC_HPP_INCLUDED
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
 #include <cstdlib>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
+
+#include <pthread.h>
 
 #include "atomic_list.hpp"
+#include "block_layout.hpp"
 #include "color.hpp"
+#include "free_span_list.hpp"
+#include "gc_stats.hpp"
 #include "impl_details.hpp"
 #include "large_block_list.hpp"
 #include "marker.hpp"
 #include "mutator.hpp"
+#include "pacer.hpp"
+#include "pause_stats.hpp"
 #include "phase.hpp"
+#include "scavenger.hpp"
+#include "snoop_buffer.hpp"
+#include "store_buffer.hpp"
 #include "stub_list.hpp"
+#include "worker_pool.hpp"
 
 namespace otf_gc
 {
@@ -25,9 +43,22 @@ namespace otf_gc
     std::atomic<list<void*>> allocation_dump;
 
     std::atomic<stub_list> small_used_lists[impl_details::small_size_classes];
+    std::atomic<stub_list> leaf_used_lists[impl_details::small_size_classes];
+    std::atomic<stub_list> medium_used_lists[impl_details::medium_size_classes];
     std::atomic<large_block_list> large_used_list;
 
-    atomic_list<stub_list> small_free_lists[impl_details::small_size_classes];
+    free_span_list small_free_lists[impl_details::small_size_classes];
+    free_span_list leaf_free_lists[impl_details::small_size_classes];
+    free_span_list medium_free_lists[impl_details::medium_size_classes];
+
+    atomic_list<stub_list> small_released_lists[impl_details::small_size_classes];
+    atomic_list<stub_list> leaf_released_lists[impl_details::small_size_classes];
+    atomic_list<stub_list> medium_released_lists[impl_details::medium_size_classes];
+
+    atomic_list<stub_list> small_sweep_queues[impl_details::small_size_classes];
+    atomic_list<stub_list> leaf_sweep_queues[impl_details::small_size_classes];
+    atomic_list<stub_list> medium_sweep_queues[impl_details::medium_size_classes];
+    atomic_list<large_block_list> large_sweep_queue;
 
     std::atomic<bool> running;
     std::atomic<color> alloc_color;
@@ -36,32 +67,86 @@ namespace otf_gc
 
     std::mutex reg_mut;
 
+    std::atomic<bool> spin_wait;
+    std::mutex wait_mut;
+    std::condition_variable wait_cv;
+
+    std::size_t marker_threads;
+    worker_pool workers;
+
+    pacer pacing;
+    scavenger scav;
+
+    std::atomic<std::uint64_t> phase_start_ns, next_mutator_id;
+    std::atomic<std::uint64_t> async_timeout_ns;
+    int async_signal;
+
+    // state carried between calls to step.
+    std::uint64_t deadline_ns;
+    std::shared_ptr<void> pending_marker;
+    bool sweep_pending;
+    std::mutex stats_mut;
+    gc_stats current_stats, last_stats;
+    std::uint64_t cycles;
+    std::function<void(const gc_stats&)> stats_callback;
+
+    // pause histograms of unregistered mutators, guarded by reg_mut.
+    pause_histograms retired_pauses;
+
     friend class mutator;
   public:
     static std::unique_ptr<gc> collector;
+
+    class registered_mutator;
   private:
+    registered_mutator* mutators;
     std::atomic<list<void*>> root_set;
-    atomic_list<list<void*>> buffer_set;
+    std::atomic<store_buffer_chunk*> buffer_set, snoop_set;
+
+    inline bool ready_to_advance()
+    {
+      return shook.load(std::memory_order_relaxed) == active.load(std::memory_order_relaxed)
+	&& (gc_phase.load(std::memory_order_relaxed) != phase(phase::phase_t::Sweep) || pacing.cycle_due());
+    }
+
+    inline bool preempted() const
+    {
+      return !running.load(std::memory_order_relaxed) || (deadline_ns && monotonic_ns() >= deadline_ns);
+    }
 
     bool try_advance()
     {
-      if(shook.load(std::memory_order_relaxed) == active.load(std::memory_order_relaxed))
+      if(ready_to_advance())
       {
 	std::lock_guard<std::mutex> lk(reg_mut);
 
-	if(shook.load(std::memory_order_relaxed) == active.load(std::memory_order_relaxed))
+	if(shook.load(std::memory_order_acquire) == active.load(std::memory_order_relaxed))
 	{
 	  shook.store(0, std::memory_order_relaxed);
 	  phase p(gc_phase.load(std::memory_order_relaxed));
 
+	  std::uint64_t now = monotonic_ns();
+
+	  if(p != phase(phase::phase_t::Sweep))
+	    current_stats.phase_ns[static_cast<std::size_t>(p.p)] += now - phase_start_ns.load(std::memory_order_relaxed);
+
+	  phase_start_ns.store(now, std::memory_order_relaxed);
+
 	  if(p == phase(phase::phase_t::Second_h))
 	  {
 	    color prev_color(alloc_color.load(std::memory_order_relaxed));
 	    alloc_color.store(prev_color.flip(), std::memory_order_relaxed);
 	  }
+	  else if(p == phase(phase::phase_t::Sweep))
+	  {
+	    pacing.begin_cycle();
+	  }
 
 	  gc_phase.store(p.advance(), std::memory_order_relaxed);
 
+	  for(registered_mutator* m = mutators; m; m = m->next_mut)
+	    m->sync_word.fetch_or(mutator::sync_requested_bit, std::memory_order_release);
+
 	  return true;
 	}
       }
@@ -69,6 +154,81 @@ namespace otf_gc
       return false;
     }
 
+    inline void wake_collector()
+    {
+      if(spin_wait.load(std::memory_order_relaxed))
+	return;
+
+      {
+	std::lock_guard<std::mutex> lk(wait_mut);
+      }
+
+      wait_cv.notify_one();
+    }
+
+    inline void handshake()
+    {
+      unsigned sh = shook.fetch_add(1, std::memory_order_relaxed) + 1;
+
+      if(sh == active.load(std::memory_order_relaxed))
+	wake_collector();
+    }
+
+    // for a signal handler, which can't take wait_mut to wake the
+    // collector; it waits at most async_timeout_ns before recounting.
+    inline void signal_handshake()
+    {
+      shook.fetch_add(1, std::memory_order_release);
+    }
+
+    inline void report_handshake(std::uint64_t id, std::uint64_t latency_ns)
+    {
+      std::lock_guard<std::mutex> lk(stats_mut);
+      current_stats.mutator_handshake_ns.emplace_back(id, latency_ns);
+    }
+
+    void publish_stats()
+    {
+      gc_stats published;
+      std::function<void(const gc_stats&)> callback;
+
+      {
+	std::lock_guard<std::mutex> lk(stats_mut);
+
+	current_stats.cycle = cycles++;
+	current_stats.max_handshake_ns = 0;
+
+	for(const auto& mh : current_stats.mutator_handshake_ns)
+	  current_stats.max_handshake_ns = std::max(current_stats.max_handshake_ns, mh.second);
+
+	published = last_stats = current_stats;
+	current_stats = gc_stats{};
+
+	callback = stats_callback;
+      }
+
+      if(callback)
+	callback(published);
+    }
+
+    void wait_for_handshakes()
+    {
+      if(spin_wait.load(std::memory_order_relaxed))
+	return;
+
+      std::unique_lock<std::mutex> lk(wait_mut);
+
+      std::chrono::nanoseconds timeout = std::chrono::microseconds(impl_details::collector_wait_timeout_us);
+      std::uint64_t async_timeout = async_timeout_ns.load(std::memory_order_relaxed);
+
+      if(async_timeout > 0)
+	timeout = std::min(timeout, std::chrono::nanoseconds(async_timeout));
+
+      wait_cv.wait_for(lk, timeout, [this]() {
+	  return !running.load(std::memory_order_relaxed) || ready_to_advance();
+	});
+    }
+
     void dump_thread_local_allocations()
     {
       list<void*> result = list_pool<void*>().reset_allocation_dump();
@@ -77,30 +237,167 @@ namespace otf_gc
       
       result.append(atomic_list_pool<list<void*>>().reset_allocation_dump());
       result.append(atomic_list_pool<stub_list>().reset_allocation_dump());
+      result.append(atomic_list_pool<large_block_list>().reset_allocation_dump());
       
       result.append(stub_list_pool().reset_allocation_dump());
 
       result.atomic_vacate_and_append(allocation_dump);
     }    
   public:
-    class registered_mutator : public mutator
+    class registered_mutator final : public mutator
     {
     private:
       friend class gc;
       
       bool inactive, snoop, trace_on;
+      std::uint64_t id, worst_handshake_ns;
       std::function<list<void*>()> root_callback;
       phase current_phase;
-      list<void*> buffer, snooped;
+      store_buffer buffer;
+      snoop_buffer snooped;
+
+      // guards inactive, and the thread local state the collector
+      // hands off on the mutator's behalf while it is inactive.
+      std::mutex region_mut;
+      registered_mutator *prev_mut, *next_mut;
+
+      std::atomic<bool> async;
+      pthread_t thread;
+
+      // the roots of a mutator in an async region, which the handler can't
+      // hand off itself since that allocates. owed is set by a Third_h
+      // handshake from the handler, and cleared under region_mut by
+      // whichever of the collector and the mutator copies them first.
+      void* const* async_roots;
+      std::size_t num_async_roots;
+      std::atomic<bool> async_roots_owed;
+
+      void hand_off_async_roots()
+      {
+	if(!async_roots_owed.load(std::memory_order_acquire))
+	  return;
+
+	list<void*> roots;
+
+	for(std::size_t i = 0; i < num_async_roots; ++i)
+	  if(async_roots[i])
+	    roots.push_front(async_roots[i]);
+
+	roots.atomic_vacate_and_append(collector->root_set);
+	async_roots_owed.store(false, std::memory_order_relaxed);
+      }
+
+      static registered_mutator*& current()
+      {
+	static thread_local registered_mutator* mut = nullptr;
+	return mut;
+      }
+
+      static void async_handshake(int)
+      {
+	int saved_errno = errno;
+	registered_mutator* mut = current();
+
+	if(mut && mut->async.load(std::memory_order_relaxed)) {
+	  phase gc_phase = collector->gc_phase.load(std::memory_order_relaxed);
+
+	  if(mut->current_phase != gc_phase) {
+	    pause_timer timer(mut->pause_rec, mut->pause_rec.histograms.handshake);
+	    mut->sync(gc_phase, true);
+	  }
+	}
+
+	errno = saved_errno;
+      }
+
+      // from_signal defers the handshake report, which allocates, to the
+      // next synchronous Fourth_h handshake, and skips everything that may
+      // lock or wake the collector.
+      void sync(phase gc_phase, bool from_signal = false)
+      {
+	current_phase = gc_phase;
+
+	std::uint64_t latency = monotonic_ns() - collector->phase_start_ns.load(std::memory_order_relaxed);
+	worst_handshake_ns = std::max(worst_handshake_ns, latency);
+
+	if(!from_signal)
+	  flush_allocation_count();
+
+	if(current_phase == phase(phase::phase_t::Third_h)) {
+	  if(from_signal) {
+	    async_roots_owed.store(true, std::memory_order_release);
+	  } else {
+	    list<void*> roots = root_callback();
+	    roots.atomic_vacate_and_append(collector->root_set);
+	  }
+
+	  snooped.atomic_vacate_and_append(collector->snoop_set);
+
+	  for(size_t i = 0; i < impl_details::small_size_classes; ++i) {
+	    if(auto small_ul = vacate_small_used_list(i))
+	      small_ul.atomic_vacate_and_append(collector->small_used_lists[i]);
+
+	    if(auto leaf_ul = vacate_leaf_used_list(i))
+	      leaf_ul.atomic_vacate_and_append(collector->leaf_used_lists[i]);
+	  }
+
+	  for(size_t i = 0; i < impl_details::medium_size_classes; ++i)
+	    if(auto medium_ul = vacate_medium_used_list(i))
+	      medium_ul.atomic_vacate_and_append(collector->medium_used_lists[i]);
+
+	  if(auto large_ul = vacate_large_used_list())
+	    large_ul.atomic_vacate_and_append(collector->large_used_list);
+
+	  alloc_color = collector->alloc_color.load(std::memory_order_relaxed);
+	} else if(current_phase == phase(phase::phase_t::Fourth_h)) {
+	  buffer.atomic_vacate_and_append(collector->buffer_set);
+
+	  if(!from_signal) {
+	    collector->report_handshake(id, worst_handshake_ns);
+	    worst_handshake_ns = 0;
+	  }
+	}
+
+	snoop = current_phase.snooping();
+	trace_on = current_phase.tracing();
+
+	// the collector can't request another sync before our handshake.
+	sync_word.store(snoop || trace_on ? barrier_on_bit : 0, std::memory_order_relaxed);
+
+	if(from_signal)
+	  collector->signal_handshake();
+	else
+	  collector->handshake();
+      }
     public:
       registered_mutator()
 	: mutator(collector->alloc_color.load(std::memory_order_relaxed))
 	, inactive(false)
 	, snoop(collector->gc_phase.load(std::memory_order_relaxed).snooping())
 	, trace_on(collector->gc_phase.load(std::memory_order_relaxed).tracing())
+	, id(collector->next_mutator_id.fetch_add(1, std::memory_order_relaxed))
+	, worst_handshake_ns(0)
 	, root_callback([]() { return nullptr; })
 	, current_phase(collector->gc_phase.load(std::memory_order_relaxed))
+	, prev_mut(nullptr)
+	, async(false)
+	, thread(pthread_self())
+	, async_roots(nullptr)
+	, num_async_roots(0)
+	, async_roots_owed(false)
       {
+	current() = this;
+
+	sync_word.store(snoop || trace_on ? barrier_on_bit : 0, std::memory_order_relaxed);
+
+	// create_mutator holds collector->reg_mut.
+	next_mut = collector->mutators;
+
+	if(next_mut)
+	  next_mut->prev_mut = this;
+
+	collector->mutators = this;
+
 	collector->active.fetch_add(1, std::memory_order_relaxed);
 	collector->shook.fetch_add(1, std::memory_order_relaxed);
       }
@@ -113,27 +410,20 @@ namespace otf_gc
 	return snoop;
       }
 
-      inline phase mut_phase() {
-	return current_phase;
-      }
-
-      inline void append_front_buffer(list<void*>&& buf) {
-	buffer = buf.append(std::move(buffer));
+      OTF_GC_ALWAYS_INLINE bool barrier_active() const {
+	return sync_word.load(std::memory_order_relaxed) != 0;
       }
 
-      inline void push_front_buffer(void* p) {
-	buffer.push_front(p);
+      inline phase mut_phase() {
+	return current_phase;
       }
 
-      inline void push_front_snooping(void* p) {
-	snooped.push_front(p);
+      inline store_buffer& log_buffer() {
+	return buffer;
       }
 
-      inline void* buffer_ptr() {
-	if(buffer.empty())
-	  return nullptr;
-	else
-	  return buffer.head_ptr();
+      OTF_GC_ALWAYS_INLINE void push_snooping(void* p) {
+	snooped.push(p);
       }
 
       inline color mut_color() const {
@@ -145,51 +435,147 @@ namespace otf_gc
 	root_callback = root_callback_;
       }
 
+      // handshakes if the collector has moved on. called implicitly when an
+      // allocation refills and after barriered writes, so every pointer the
+      // mutator holds across an allocation or a barriered write must be
+      // visible to its root callback.
+      OTF_GC_NOINLINE void safepoint() override
+      {
+	sync_word.fetch_and(~sync_requested_bit, std::memory_order_acquire);
+	poll_for_sync();
+      }
+
       inline void poll_for_sync()
       {
+	// inside an async region the signal handler handshakes instead.
+	assert(!inactive && !async.load(std::memory_order_relaxed));
+	phase gc_phase = collector->gc_phase.load(std::memory_order_relaxed);
+
+	if(current_phase != gc_phase) {
+	  pause_timer timer(pause_rec, pause_rec.histograms.handshake);
+	  sync(gc_phase);
+	}
+      }
+
+      // inside a safe region the mutator must neither allocate nor write
+      // through a barrier, and its root callback must be callable from
+      // the collector thread, which handshakes on its behalf.
+      void enter_safe_region()
+      {
+	std::lock_guard<std::mutex> lk(region_mut);
 	assert(!inactive);
+
+	inactive = true;
 	phase gc_phase = collector->gc_phase.load(std::memory_order_relaxed);
 
-	if(current_phase != gc_phase)
+	if(current_phase != gc_phase) {
+	  pause_timer timer(pause_rec, pause_rec.histograms.handshake);
+	  sync(gc_phase);
+	}
+      }
+
+      void leave_safe_region()
+      {
 	{
-	  current_phase = gc_phase;
+	  std::lock_guard<std::mutex> lk(region_mut);
+	  assert(inactive);
 
-	  if(current_phase == phase(phase::phase_t::Third_h)) {
-	    list<void*> roots = root_callback();
+	  inactive = false;
+	}
 
-	    roots.append(std::move(snooped));
-	    roots.atomic_vacate_and_append(collector->root_set);
+	poll_for_sync();
+      }
 
-	    for(size_t i = 0; i < impl_details::small_size_classes; ++i)
-	      if(auto small_ul = vacate_small_used_list(i))
-		small_ul.atomic_vacate_and_append(collector->small_used_lists[i]);
+      // once the async handshake timeout passes, a mutator lagging inside
+      // an async region is sent the async handshake signal, and handshakes
+      // from the handler on its own stack. inside the region the mutator
+      // must neither allocate nor write through a barrier. its root
+      // callback isn't called there: its roots are the num_roots pointers
+      // at roots, which the collector copies and which must stay valid and
+      // unchanged until the region is left. the mutator must be used from
+      // the thread that created it.
+      void enter_async_region(void* const* roots, std::size_t num_roots)
+      {
+	assert(!inactive && !async.load(std::memory_order_relaxed) && pthread_equal(thread, pthread_self()));
 
-	    if(auto large_ul = vacate_large_used_list())
-	      large_ul.atomic_vacate_and_append(collector->large_used_list);
+	poll_for_sync();
+	flush_used_spans();
 
-	    alloc_color = collector->alloc_color.load(std::memory_order_relaxed);
-	  } else if(current_phase == phase(phase::phase_t::Fourth_h)) {
-	    collector->buffer_set.push_front(buffer);
-	    buffer.reset();
-	  }
+	async_roots = roots;
+	num_async_roots = num_roots;
+
+	async.store(true, std::memory_order_relaxed);
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+      }
+
+      void leave_async_region()
+      {
+	assert(async.load(std::memory_order_relaxed));
 
-	  snoop = current_phase.snooping();
-	  trace_on = current_phase.tracing();
+	async.store(false, std::memory_order_relaxed);
+	std::atomic_signal_fence(std::memory_order_seq_cst);
 
-	  collector->shook.fetch_add(1, std::memory_order_relaxed);
+	{
+	  std::lock_guard<std::mutex> lk(region_mut);
+	  hand_off_async_roots();
 	}
+
+	async_roots = nullptr;
+	num_async_roots = 0;
+
+	poll_for_sync();
       }
 
       ~registered_mutator()
       {
-	collector->buffer_set.push_front(buffer);
+	if(inactive)
+	  leave_safe_region();
+
+	if(async.load(std::memory_order_relaxed))
+	  leave_async_region();
+
+	if(current() == this)
+	  current() = nullptr;
+
+	flush_allocation_count();
+
+	if(worst_handshake_ns > 0)
+	  collector->report_handshake(id, worst_handshake_ns);
+
+	buffer.atomic_vacate_and_append(collector->buffer_set);
+
+	if(snoop)
+	  snooped.atomic_vacate_and_append(collector->snoop_set);
 
 	for(size_t i = 0; i < impl_details::small_size_classes; ++i) {
+	  if(auto tail = fixed_managers[i].release_alloc_span())
+	    collector->small_free_lists[i].push_front(tail);
+
 	  if(auto fl = fixed_managers[i].release_free_list())
 	    collector->small_free_lists[i].push_front(fl);
 
 	  if(auto ul = fixed_managers[i].release_used_list())
 	    ul.atomic_vacate_and_append(collector->small_used_lists[i]);
+
+	  if(auto tail = leaf_managers[i].release_alloc_span())
+	    collector->leaf_free_lists[i].push_front(tail);
+
+	  if(auto fl = leaf_managers[i].release_free_list())
+	    collector->leaf_free_lists[i].push_front(fl);
+
+	  if(auto ul = leaf_managers[i].release_used_list())
+	    ul.atomic_vacate_and_append(collector->leaf_used_lists[i]);
+	}
+
+	for(size_t i = 0; i < impl_details::medium_size_classes; ++i) {
+	  if(auto tail = medium_managers[i].release_alloc_span())
+	    collector->medium_free_lists[i].push_front(tail);
+
+	  if(auto fl = medium_managers[i].release_free_list())
+	    collector->medium_free_lists[i].push_front(fl);
+
+	  if(auto ul = medium_managers[i].release_used_list())
+	    ul.atomic_vacate_and_append(collector->medium_used_lists[i]);
 	}
 
 	collector->dump_thread_local_allocations();
@@ -198,10 +584,61 @@ namespace otf_gc
 
 	std::lock_guard<std::mutex> lk(collector->reg_mut);
 
-	collector->active.fetch_sub(!inactive, std::memory_order_relaxed);
+	collector->retired_pauses.merge(pause_rec.histograms);
+
+	if(prev_mut)
+	  prev_mut->next_mut = next_mut;
+	else
+	  collector->mutators = next_mut;
+
+	if(next_mut)
+	  next_mut->prev_mut = prev_mut;
 
-	if(!inactive && current_phase == collector->gc_phase.load(std::memory_order_relaxed))
+	collector->active.fetch_sub(1, std::memory_order_relaxed);
+
+	if(current_phase == collector->gc_phase.load(std::memory_order_relaxed))
 	  collector->shook.fetch_sub(1, std::memory_order_relaxed);
+
+	if(collector->shook.load(std::memory_order_relaxed) == collector->active.load(std::memory_order_relaxed))
+	  collector->wake_collector();
+      }
+    };
+
+    class safe_region
+    {
+    private:
+      registered_mutator& mut;
+    public:
+      explicit safe_region(registered_mutator& mut_) : mut(mut_)
+      {
+	mut.enter_safe_region();
+      }
+
+      safe_region(const safe_region&) = delete;
+      safe_region& operator=(const safe_region&) = delete;
+
+      ~safe_region()
+      {
+	mut.leave_safe_region();
+      }
+    };
+
+    class async_region
+    {
+    private:
+      registered_mutator& mut;
+    public:
+      async_region(registered_mutator& mut_, void* const* roots, std::size_t num_roots) : mut(mut_)
+      {
+	mut.enter_async_region(roots, num_roots);
+      }
+
+      async_region(const async_region&) = delete;
+      async_region& operator=(const async_region&) = delete;
+
+      ~async_region()
+      {
+	mut.leave_async_region();
       }
     };
   private:
@@ -209,42 +646,90 @@ namespace otf_gc
       : running(false)
       , active(0)
       , shook(0)
+      , spin_wait(false)
+      , marker_threads(impl_details::default_marker_threads)
+      , phase_start_ns(monotonic_ns())
+      , next_mutator_id(0)
+      , async_timeout_ns(0)
+      , async_signal(0)
+      , deadline_ns(0)
+      , sweep_pending(false)
+      , current_stats{}
+      , last_stats{}
+      , cycles(0)
+      , mutators(nullptr)
+      , buffer_set(nullptr)
+      , snoop_set(nullptr)
     {}
 
-    impl_details::underlying_header_t header(void* p)
+    // handshakes on behalf of mutators in safe regions and, once tracing
+    // begins, hands off the roots of those handshaking from async regions.
+    void sync_safe_regions()
     {
-      impl_details::header_t& h = *reinterpret_cast<impl_details::header_t*>(p);
-      return h.load(std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lk(reg_mut);
+      phase p(gc_phase.load(std::memory_order_relaxed));
+
+      for(registered_mutator* m = mutators; m; m = m->next_mut) {
+	std::lock_guard<std::mutex> rlk(m->region_mut);
+
+	if(m->inactive && m->current_phase != p)
+	  m->sync(p);
+
+	// every handshake is in, so any async roots are owed by now.
+	if(p == phase(phase::phase_t::Tracing))
+	  m->hand_off_async_roots();
+      }
     }
 
-    template <class Policy>
-    void destroy_objects()
+    void signal_lagging_mutators()
     {
-      using namespace impl_details;
+      std::uint64_t timeout = async_timeout_ns.load(std::memory_order_relaxed);
 
-      stub_list remaining_used;
+      if(timeout == 0 || monotonic_ns() - phase_start_ns.load(std::memory_order_relaxed) < timeout)
+	return;
 
-      for(size_t i = 0; i < impl_details::small_size_classes; ++i)
-      {
-      	remaining_used = small_used_lists[i].exchange(nullptr, std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lk(reg_mut);
 
-	while(remaining_used) {
-	  stub* st = remaining_used.front();
-	  remaining_used.pop_front();
+      for(registered_mutator* m = mutators; m; m = m->next_mut)
+	if(m->async.load(std::memory_order_relaxed) && m->sync_requested())
+	  pthread_kill(m->thread, async_signal);
+    }
 
-	  for(auto p = reinterpret_cast<std::uint64_t>(st->start);
-	      p < reinterpret_cast<std::uint64_t>(st->start) + st->size;
-	      p += (1ULL << (i+3)))
-	  {
-	    underlying_header_t h = header(reinterpret_cast<void*>(p + log_ptr_size));
+    template <class Policy, class Layout>
+    void destroy_span_objects(std::atomic<stub_list>& used_list, std::size_t stride)
+    {
+      using namespace impl_details;
 
-	    Policy::destroy(h, reinterpret_cast<header_t*>(p + log_ptr_size));
+      stub_list remaining_used = used_list.exchange(nullptr, std::memory_order_relaxed);
 
-	    reinterpret_cast<log_ptr_t*>(p)->~log_ptr_t();
-	    reinterpret_cast<header_t*>(p + log_ptr_size)->~header_t();
-	  }
+      while(remaining_used) {
+	stub* st = remaining_used.front();
+	remaining_used.pop_front();
+
+	for(auto p = reinterpret_cast<std::uint64_t>(st->start);
+	    p < reinterpret_cast<std::uint64_t>(st->start) + st->size;
+	    p += stride)
+	{
+	  underlying_header_t h = Layout::header(p)->load(std::memory_order_relaxed);
+
+	  Policy::destroy(h, Layout::header(p));
+	  Layout::destroy_metadata(p);
 	}
       }
+    }
+
+    template <class Policy>
+    void destroy_objects()
+    {
+      using namespace impl_details;
+
+      for(size_t i = 0; i < impl_details::small_size_classes; ++i) {
+	destroy_span_objects<Policy, small_layout>(small_used_lists[i], small_class_size(i));
+	destroy_span_objects<Policy, leaf_layout>(leaf_used_lists[i], small_class_size(i));
+      }
+
+      for(size_t i = 0; i < impl_details::medium_size_classes; ++i)
+	destroy_span_objects<Policy, medium_layout>(medium_used_lists[i], medium_class_size(i));
 
       large_block_list processed_large_used;
       large_block_list remaining_large_used =
@@ -273,6 +758,9 @@ namespace otf_gc
     {
       while(active.load(std::memory_order_relaxed) > 0);
 
+      pending_marker.reset();
+      drain_sweep_queues();
+
       destroy_objects<Policy>();
 
       list<void*> records =
@@ -309,174 +797,272 @@ namespace otf_gc
     inline void stop()
     {
       running.store(false, std::memory_order_relaxed);
+
+      {
+	std::lock_guard<std::mutex> lk(wait_mut);
+      }
+
+      wait_cv.notify_one();
     }
 
-    template <class Tracer>
-    inline void clear_buffers()
+    inline void set_spin_wait(bool spin)
     {
-      using namespace impl_details;
+      spin_wait.store(spin, std::memory_order_relaxed);
+    }
 
-      while(!buffer_set.empty())
-      {
-	list<void*> buf(buffer_set.pop_front());
+    inline void set_heap_growth_target(std::size_t percent)
+    {
+      pacing.set_growth_percent(percent);
+      wake_collector();
+    }
 
-	while(!buf.empty()) {
-	  void* root = buf.front();
-	  buf.pop_front();
+    inline void set_retained_memory_target(std::size_t bytes)
+    {
+      scav.set_retained_target(bytes);
+    }
 
-	  if(!root) continue;
+    inline void set_scavenge_rate_limit(std::size_t bytes)
+    {
+      scav.set_rate_limit(bytes);
+    }
 
-	  auto rp = reinterpret_cast<std::ptrdiff_t>(root);
+    inline gc_stats stats()
+    {
+      std::lock_guard<std::mutex> lk(stats_mut);
+      return last_stats;
+    }
 
-	  if(rp & 1ULL)
-	  {
-	    rp = rp ^ 1ULL;
+    inline void set_stats_callback(std::function<void(const gc_stats&)> callback)
+    {
+      std::lock_guard<std::mutex> lk(stats_mut);
+      stats_callback = callback;
+    }
 
-	    header_t* header_w = reinterpret_cast<header_t*>(rp - header_size);
-	    underlying_header_t header_c = header_w->load(std::memory_order_relaxed);
+    // merges the pause histograms of every mutator, live or retired, and
+    // computes the MMU of each live mutator over its recent pauses.
+    pause_report pause_stats(const std::vector<std::uint64_t>& windows_ns = { 1000000, 10000000, 100000000 })
+    {
+      std::unique_ptr<pause_histograms> merged(new pause_histograms);
+      pause_report report;
 
-	    size_t num_log_ptrs = Tracer::num_log_ptrs(header_c);
+      for(std::uint64_t w : windows_ns)
+	report.mmu.push_back({ w, 1.0, false });
 
-	    for(std::size_t p = rp - header_size - num_log_ptrs * log_ptr_size;
-		p < rp - header_size;
-		p += log_ptr_size)
-	      reinterpret_cast<log_ptr_t*>(p)->store(nullptr);
+      {
+	std::lock_guard<std::mutex> lk(reg_mut);
+
+	merged->merge(retired_pauses);
+
+	for(registered_mutator* m = mutators; m; m = m->next_mut) {
+	  merged->merge(m->pause_rec.histograms);
+
+	  std::uint64_t begin_ns;
+	  std::vector<pause_event> pauses = m->pause_rec.log.snapshot(begin_ns);
+	  std::uint64_t end_ns = monotonic_ns();
+
+	  for(mmu_point& pt : report.mmu) {
+	    // a window longer than the log's span can't be measured.
+	    if(begin_ns + pt.window_ns > end_ns)
+	      continue;
+
+	    double u = minimum_mutator_utilization(pauses, pt.window_ns, begin_ns, end_ns);
+
+	    pt.utilization = pt.available ? std::min(pt.utilization, u) : u;
+	    pt.available = true;
 	  }
 	}
       }
+
+      report.handshake = merged->handshake.summary();
+      report.allocation = merged->allocation.summary();
+      report.barrier = merged->barrier.summary();
+
+      pause_histogram all;
+
+      all.merge(merged->handshake);
+      all.merge(merged->allocation);
+      all.merge(merged->barrier);
+
+      report.all = all.summary();
+
+      return report;
     }
 
-    template <class Policy>
-    void sweep(color free_color)
+    inline void request_cycle()
+    {
+      pacing.request_cycle();
+      wake_collector();
+    }
+
+    // a timeout of 0 disables async handshakes. signo defaults to SIGRTMIN,
+    // and its handler is installed by the first call.
+    void set_async_handshake_timeout(std::size_t timeout_us, int signo = 0)
+    {
+      std::lock_guard<std::mutex> lk(reg_mut);
+
+      if(async_signal == 0 && timeout_us > 0) {
+	struct sigaction sa;
+
+	sa.sa_handler = &registered_mutator::async_handshake;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	async_signal = signo ? signo : SIGRTMIN;
+	sigaction(async_signal, &sa, nullptr);
+      }
+
+      async_timeout_ns.store(timeout_us * 1000, std::memory_order_relaxed);
+    }
+
+    inline void set_marker_threads(std::size_t n)
+    {
+      assert(n > 0 && !running.load(std::memory_order_relaxed));
+      marker_threads = n;
+    }
+
+    template <class Tracer>
+    inline void clear_buffers()
     {
       using namespace impl_details;
 
-      static size_t ticks = 0;
+      store_buffer_chunk* c = buffer_set.exchange(nullptr, std::memory_order_acquire);
 
-      stub_list remaining_free, remaining_used, processed_used;      
+      while(c)
+      {
+	for(void** rec = c->slots; rec < c->slots + c->used; rec += store_buffer::record_size(rec))
+	{
+	  assert((reinterpret_cast<std::ptrdiff_t>(rec[0]) & 1ULL) != 0ULL);
 
-      for(size_t i = 0; i < impl_details::small_size_classes; ++i)
+	  auto rp = reinterpret_cast<std::ptrdiff_t>(store_buffer::record_parent(rec));
+
+	  header_t* header_w = reinterpret_cast<header_t*>(rp - header_size);
+	  underlying_header_t header_c = header_w->load(std::memory_order_relaxed);
+
+	  size_t num_log_ptrs = Tracer::num_log_ptrs(header_c);
+
+	  for(std::size_t p = rp - header_size - num_log_ptrs * log_ptr_size;
+	      p < rp - header_size;
+	      p += log_ptr_size)
+	    reinterpret_cast<log_ptr_t*>(p)->store(nullptr);
+	}
+
+	store_buffer_chunk* next = c->next;
+	store_buffer_chunk::destroy(c);
+	c = next;
+      }
+    }
+
+    template <class Policy, class Layout>
+    bool sweep_span(std::size_t stride,
+		    std::atomic<stub_list>& used_list,
+		    free_span_list& free_list,
+		    stub_list& remaining_used,
+		    color free_color,
+		    std::size_t& ticks,
+		    size_class_stats& stats)
+    {
+      using namespace impl_details;
+
+      stub_list remaining_free, processed_used;
+
+      while(remaining_used)
       {
-      	remaining_used = small_used_lists[i].exchange(nullptr, std::memory_order_relaxed);
-
-      	while(remaining_used)
-      	{
-      	  stub* st = remaining_used.front();
-      	  remaining_used.pop_front();
-
-      	  while(remaining_used)
-      	  {
-      	    stub* new_st = remaining_used.front();
-      	    void* offset = reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(st->start) + st->size);
-
-      	    if(offset == new_st->start) {
-      	      st->size += new_st->size;
-      	      remaining_used.pop_front();
-      	      delete new_st;
-      	    } else {
-      	      break;
-      	    }
-      	  }
-
-      	  for(auto p = reinterpret_cast<std::uint64_t>(st->start);
-      	      p < reinterpret_cast<std::uint64_t>(st->start) + st->size;
-      	      p += (1ULL << (i+3)))
-      	  {
-      	    underlying_header_t h = header(reinterpret_cast<void*>(p + log_ptr_size));
-      	    bool free_status = color(h & header_color_mask) == free_color;
-
-	    if(ticks % tick_frequency == 0 && !running.load(std::memory_order_relaxed)) {
-	      processed_used.push_front(new stub(reinterpret_cast<void*>(p),
-						 reinterpret_cast<std::uint64_t>(st->start) + st->size - p));
-
-	      processed_used.atomic_vacate_and_append(small_used_lists[i]);
-	      remaining_used.atomic_vacate_and_append(small_used_lists[i]);
-
-	      return;
+	stub* st = remaining_used.front();
+	remaining_used.pop_front();
+
+	while(remaining_used)
+	{
+	  stub* new_st = remaining_used.front();
+	  void* offset = reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(st->start) + st->size);
+
+	  if(offset == new_st->start) {
+	    st->size += new_st->size;
+	    remaining_used.pop_front();
+	    delete new_st;
+	  } else {
+	    break;
+	  }
+	}
+
+	// counting this stub first means each call sweeps at least one,
+	// so step makes progress however small its budget.
+	if(++ticks % tick_frequency == 0 && preempted()) {
+	  remaining_used.push_front(st);
+	  processed_used.atomic_vacate_and_append(used_list);
+
+	  if(remaining_free)
+	    free_list.push_front(remaining_free);
+
+	  return false;
+	}
+
+	const auto end = reinterpret_cast<std::uint64_t>(st->start) + st->size;
+	auto p = reinterpret_cast<std::uint64_t>(st->start);
+
+	underlying_header_t h = Layout::header(p)->load(std::memory_order_relaxed);
+	bool free_status = color(h & header_color_mask) == free_color;
+	size_t coalesced = 0;
+
+	for(; p < end; p += stride, coalesced += stride)
+	{
+	  if(coalesced > 0) {
+	    if(++ticks % tick_frequency == 0 && remaining_free) {
+	      free_list.push_front(remaining_free);
+	      remaining_free.reset();
 	    }
 
-      	    if(free_status) {
-      	      Policy::destroy(h, reinterpret_cast<header_t*>(p + log_ptr_size));
-
-      	      reinterpret_cast<log_ptr_t*>(p)->~log_ptr_t();
-      	      reinterpret_cast<header_t*>(p + log_ptr_size)->~header_t();
-      	    }
-
-      	    size_t coalesced = 1ULL << (i+3);
-
-      	    if(free_status) {
-      	      for(p += (1ULL << (i+3));
-      		  p < reinterpret_cast<std::uint64_t>(st->start) + st->size;
-      		  p += (1ULL << (i+3)))
-      	      {
-      		if(++ticks % tick_frequency == 0) {
-		  small_free_lists[i].push_front(remaining_free);
-		  remaining_free.reset();
-      		}
-
-      		h = header(reinterpret_cast<void*>(p + log_ptr_size));
-
-      		if(color(h & header_color_mask) == free_color)
-      		{
-      		  Policy::destroy(h, reinterpret_cast<header_t*>(p + log_ptr_size));
-
-      		  reinterpret_cast<log_ptr_t*>(p)->~log_ptr_t();
-      		  reinterpret_cast<header_t*>(p + log_ptr_size)->~header_t();
-
-      		  coalesced += 1ULL << (i+3);
-      		} else {
-      		  break;
-      		}
-      	      }
-      	    } else {
-      	      for(p += (1ULL << (i+3));
-      		  p < reinterpret_cast<std::uint64_t>(st->start) + st->size;
-      		  p += (1ULL << (i+3)))
-      	      {
-      		if(++ticks % tick_frequency == 0) {
-		  small_free_lists[i].push_front(remaining_free);
-		  remaining_free.reset();
-      		}
-
-      		h = header(reinterpret_cast<void*>(p + log_ptr_size));
-
-      		if(color(h & header_color_mask) != free_color) {
-      		  coalesced += 1ULL << (i+3);
-      		} else {
-      		  break;
-      		}
-      	      }
-      	    }
-
-      	    if(coalesced < st->size)
-      	    {
-      	      stub* new_stub = new stub(reinterpret_cast<void*>(p), st->size - coalesced);
-      	      st->size = coalesced;
-
-      	      free_status ? remaining_free.push_front(st) : processed_used.push_front(st);
-      	      remaining_used.push_front(new_stub);
-      	      break;
-      	    } else {
-      	      assert(p == reinterpret_cast<underlying_header_t>(st->start) + st->size - (1ULL << (i+3)));
-      	      free_status ? remaining_free.push_front(st) : processed_used.push_front(st);
-      	    }
-      	  }
-      	}
-
-      	processed_used.atomic_vacate_and_append(small_used_lists[i]);
-
-	small_free_lists[i].push_front(remaining_free);
-	remaining_free.reset();
+	    h = Layout::header(p)->load(std::memory_order_relaxed);
+
+	    if((color(h & header_color_mask) == free_color) != free_status)
+	      break;
+	  }
+
+	  if(free_status) {
+	    Policy::destroy(h, Layout::header(p));
+	    Layout::destroy_metadata(p);
+	  }
+	}
+
+	if(coalesced < st->size) {
+	  stub* new_stub = new stub(reinterpret_cast<void*>(p), st->size - coalesced);
+	  st->size = coalesced;
+
+	  remaining_used.push_front(new_stub);
+	} else {
+	  assert(p == end);
+	}
+
+	if(free_status) {
+	  remaining_free.push_front(st);
+	  stats.objects_freed += coalesced / stride;
+	  stats.bytes_freed += coalesced;
+	} else {
+	  processed_used.push_front(st);
+	  stats.objects_live += coalesced / stride;
+	  stats.bytes_live += coalesced;
+	}
       }
 
-      large_block_list remaining_large_used =
-	large_used_list.exchange(nullptr, std::memory_order_relaxed);
+      processed_used.atomic_vacate_and_append(used_list);
+
+      if(remaining_free)
+	free_list.push_front(remaining_free);
+
+      return true;
+    }
+
+    template <class Policy>
+    bool sweep_large(large_block_list& remaining_large_used,
+		     color free_color,
+		     std::size_t& ticks,
+		     size_class_stats& stats)
+    {
+      using namespace impl_details;
+
       large_block_list processed_large_used;
 
       while(remaining_large_used)
       {
-	using namespace impl_details;
-
 	void* fr = remaining_large_used.front();
 	remaining_large_used.pop_front();
 
@@ -486,25 +1072,207 @@ namespace otf_gc
 	underlying_header_t h = blk_c.header()->load(std::memory_order_relaxed);
 	bool free_status = color(h & header_color_mask) == free_color;
 
-	if(ticks % tick_frequency == 0 && !running.load(std::memory_order_relaxed)) {
+	if(++ticks % tick_frequency == 0 && preempted()) {
 	  remaining_large_used.push_front(blk_c);
-
-	  remaining_large_used.atomic_vacate_and_append(large_used_list);
 	  processed_large_used.atomic_vacate_and_append(large_used_list);
 
-	  return;
+	  return false;
 	}
 
 	if(free_status)
 	{
+	  ++stats.objects_freed;
+	  stats.bytes_freed += blk_c.size();
+
 	  Policy::destroy(h, blk_c.header());
 	  free(reinterpret_cast<void*>(blk_c.start()));
 	} else {
 	  processed_large_used.push_front(blk_c);
+
+	  ++stats.objects_live;
+	  stats.bytes_live += blk_c.size();
 	}
       }
-      
+
       processed_large_used.atomic_vacate_and_append(large_used_list);
+
+      return true;
+    }
+
+    void enqueue_sweep_batches(std::atomic<stub_list>& used_list, atomic_list<stub_list>& sweep_queue)
+    {
+      stub_list remaining_used = used_list.exchange(nullptr, std::memory_order_relaxed);
+
+      while(remaining_used) {
+	stub_list batch;
+
+	for(size_t n = 0; remaining_used && n < impl_details::sweep_batch_size; ++n)
+	  batch.push_back(remaining_used.node_pop_front());
+
+	sweep_queue.push_front(batch);
+      }
+    }
+
+    template <class Policy, class Layout>
+    bool sweep_queue(std::size_t stride,
+		     atomic_list<stub_list>& queue,
+		     std::atomic<stub_list>& used_list,
+		     free_span_list& free_list,
+		     color free_color,
+		     std::size_t& ticks,
+		     size_class_stats& stats)
+    {
+      while(stub_list batch = queue.pop_front())
+	if(!sweep_span<Policy, Layout>(stride, used_list, free_list, batch, free_color, ticks, stats)) {
+	  queue.push_front(batch);
+	  return false;
+	}
+
+      return true;
+    }
+
+    void enqueue_sweep()
+    {
+      using namespace impl_details;
+
+      for(size_t i = 0; i < impl_details::small_size_classes; ++i) {
+	enqueue_sweep_batches(small_used_lists[i], small_sweep_queues[i]);
+	enqueue_sweep_batches(leaf_used_lists[i], leaf_sweep_queues[i]);
+      }
+
+      for(size_t i = 0; i < impl_details::medium_size_classes; ++i)
+	enqueue_sweep_batches(medium_used_lists[i], medium_sweep_queues[i]);
+
+      large_block_list remaining_large_used =
+	large_used_list.exchange(nullptr, std::memory_order_relaxed);
+
+      while(remaining_large_used) {
+	large_block_list batch;
+
+	for(size_t n = 0; remaining_large_used && n < sweep_batch_size; ++n) {
+	  void* fr = remaining_large_used.front();
+	  remaining_large_used.pop_front();
+	  batch.push_back(fr);
+	}
+
+	large_sweep_queue.push_front(batch);
+      }
+    }
+
+    // returns false if preempted, leaving the unswept batches queued.
+    template <class Policy>
+    bool resume_sweep(color free_color, heap_stats& heap)
+    {
+      using namespace impl_details;
+
+      std::mutex heap_mut;
+      std::atomic<bool> complete(true);
+
+      workers.run([this, free_color, &heap, &heap_mut, &complete](std::size_t id) {
+	  std::size_t ticks = 0;
+	  bool swept = true;
+	  heap_stats local{};
+
+	  for(size_t k = 0; swept && k < impl_details::small_size_classes; ++k)
+	  {
+	    size_t i = (id + k) % impl_details::small_size_classes;
+
+	    swept = sweep_queue<Policy, small_layout>(small_class_size(i), small_sweep_queues[i],
+						      small_used_lists[i], small_free_lists[i],
+						      free_color, ticks, local.small[i])
+	      && sweep_queue<Policy, leaf_layout>(small_class_size(i), leaf_sweep_queues[i],
+						  leaf_used_lists[i], leaf_free_lists[i],
+						  free_color, ticks, local.leaf[i]);
+	  }
+
+	  for(size_t k = 0; swept && k < impl_details::medium_size_classes; ++k)
+	  {
+	    size_t i = (id + k) % impl_details::medium_size_classes;
+
+	    swept = sweep_queue<Policy, medium_layout>(medium_class_size(i), medium_sweep_queues[i],
+						       medium_used_lists[i], medium_free_lists[i],
+						       free_color, ticks, local.medium[i]);
+	  }
+
+	  while(swept)
+	    if(large_block_list batch = large_sweep_queue.pop_front()) {
+	      swept = sweep_large<Policy>(batch, free_color, ticks, local.large);
+
+	      if(!swept)
+		large_sweep_queue.push_front(batch);
+	    } else {
+	      break;
+	    }
+
+	  if(!swept)
+	    complete.store(false, std::memory_order_relaxed);
+
+	  std::lock_guard<std::mutex> lk(heap_mut);
+	  heap.merge(local);
+	});
+
+      return complete.load(std::memory_order_relaxed);
+    }
+
+    void drain_sweep_queues()
+    {
+      for(size_t i = 0; i < impl_details::small_size_classes; ++i) {
+	while(stub_list batch = small_sweep_queues[i].pop_front())
+	  batch.atomic_vacate_and_append(small_used_lists[i]);
+
+	while(stub_list batch = leaf_sweep_queues[i].pop_front())
+	  batch.atomic_vacate_and_append(leaf_used_lists[i]);
+      }
+
+      for(size_t i = 0; i < impl_details::medium_size_classes; ++i)
+	while(stub_list batch = medium_sweep_queues[i].pop_front())
+	  batch.atomic_vacate_and_append(medium_used_lists[i]);
+
+      while(large_block_list batch = large_sweep_queue.pop_front())
+	batch.atomic_vacate_and_append(large_used_list);
+    }
+
+    template <class Policy>
+    void sweep(color free_color, heap_stats& heap)
+    {
+      enqueue_sweep();
+      resume_sweep<Policy>(free_color, heap);
+      drain_sweep_queues();
+    }
+
+    template <class Tracer>
+    void finish_cycle()
+    {
+      clear_buffers<Tracer>();
+
+      pacing.end_cycle(current_stats.heap.live_bytes());
+      scavenge();
+
+      current_stats.phase_ns[static_cast<std::size_t>(phase::phase_t::Sweep)] =
+	monotonic_ns() - phase_start_ns.load(std::memory_order_relaxed);
+
+      publish_stats();
+    }
+
+    void scavenge()
+    {
+      std::size_t free_total = 0;
+
+      for(size_t i = 0; i < impl_details::small_size_classes; ++i)
+	free_total += scav.free_bytes(small_free_lists[i]) + scav.free_bytes(leaf_free_lists[i]);
+
+      for(size_t i = 0; i < impl_details::medium_size_classes; ++i)
+	free_total += scav.free_bytes(medium_free_lists[i]);
+
+      std::size_t quota = scav.quota(free_total);
+
+      for(size_t i = impl_details::medium_size_classes; i > 0 && quota > 0; --i)
+	scav.scavenge(medium_free_lists[i-1], medium_released_lists[i-1], quota);
+
+      for(size_t i = impl_details::small_size_classes; i > 0 && quota > 0; --i) {
+	scav.scavenge(small_free_lists[i-1], small_released_lists[i-1], quota);
+	scav.scavenge(leaf_free_lists[i-1], leaf_released_lists[i-1], quota);
+      }
     }
 
     template <class Policy, class Tracer>
@@ -512,12 +1280,16 @@ namespace otf_gc
     {
       running.store(true, std::memory_order_relaxed);
 
+      workers.start(marker_threads, [this]() { dump_thread_local_allocations(); });
+
       while(running.load(std::memory_order_relaxed))
       {
 	assert(shook.load(std::memory_order_relaxed) <= active.load(std::memory_order_relaxed));
 
 	if(try_advance())
 	{
+	  sync_safe_regions();
+
 	  phase::phase_t p = gc_phase.load(std::memory_order_relaxed);
 
 	  switch(p)
@@ -525,24 +1297,88 @@ namespace otf_gc
 	  case phase::phase_t::Tracing:
 	    {
 	      list<void*> r = root_set.exchange(nullptr, std::memory_order_relaxed);
+	      store_buffer_chunk* snooped = snoop_set.exchange(nullptr, std::memory_order_acquire);
+
+	      marker<Tracer> m(std::move(r), snooped, running, workers.size());
+	      m.mark(alloc_color.load(std::memory_order_relaxed), workers);
 
-	      marker<Tracer> m(std::move(r), running);
-	      m.mark(alloc_color.load(std::memory_order_relaxed));
+	      current_stats.objects_marked = m.objects_marked();
+	      current_stats.bytes_marked = m.bytes_marked();
 
 	      break;
 	    }
 	  case phase::phase_t::Sweep:
-	    sweep<Policy>(alloc_color.load(std::memory_order_relaxed).flip());
-	    clear_buffers<Tracer>();
-	    break;
+	    {
+	      sweep<Policy>(alloc_color.load(std::memory_order_relaxed).flip(), current_stats.heap);
+	      finish_cycle<Tracer>();
+	      break;
+	    }
 
 	  default:
 	    break;
 	  }
+	} else {
+	  wait_for_handshakes();
+	  signal_lagging_mutators();
 	}
       }
 
-      dump_thread_local_allocations();            
+      workers.stop();
+      dump_thread_local_allocations();
+    }
+
+    // an alternative to run for embedders without a collector thread:
+    // advances the phase machine and marks or sweeps for about budget_ns,
+    // resuming at the same point on the next call. returns early when
+    // mutators still owe a handshake, so a mutator stepping the collector
+    // from its own thread should poll_for_sync between steps.
+    template <class Policy, class Tracer>
+    void step(std::uint64_t budget_ns)
+    {
+      running.store(true, std::memory_order_relaxed);
+      deadline_ns = monotonic_ns() + budget_ns;
+
+      do {
+	if(pending_marker) {
+	  marker<Tracer>& m = *static_cast<marker<Tracer>*>(pending_marker.get());
+
+	  m.mark(alloc_color.load(std::memory_order_relaxed), workers, deadline_ns);
+
+	  // the marker's counts are cumulative, so these overwrite the last step's.
+	  current_stats.objects_marked = m.objects_marked();
+	  current_stats.bytes_marked = m.bytes_marked();
+
+	  if(!m.finished())
+	    break;
+
+	  pending_marker.reset();
+	} else if(sweep_pending) {
+	  if(!resume_sweep<Policy>(alloc_color.load(std::memory_order_relaxed).flip(), current_stats.heap))
+	    break;
+
+	  sweep_pending = false;
+	  finish_cycle<Tracer>();
+	} else if(try_advance()) {
+	  sync_safe_regions();
+
+	  phase::phase_t p = gc_phase.load(std::memory_order_relaxed);
+
+	  if(p == phase::phase_t::Tracing) {
+	    list<void*> r = root_set.exchange(nullptr, std::memory_order_relaxed);
+	    store_buffer_chunk* snooped = snoop_set.exchange(nullptr, std::memory_order_acquire);
+
+	    pending_marker = std::make_shared<marker<Tracer>>(std::move(r), snooped, running, workers.size());
+	  } else if(p == phase::phase_t::Sweep) {
+	    enqueue_sweep();
+	    sweep_pending = true;
+	  }
+	} else {
+	  signal_lagging_mutators();
+	  break;
+	}
+      } while(monotonic_ns() < deadline_ns);
+
+      deadline_ns = 0;
     }
   };
 }
@@ -0,0 +1,86 @@
+#ifndef GC_STATS_HPP_INCLUDED
+#define GC_STATS_HPP_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "impl_details.hpp"
+
+namespace otf_gc
+{
+  inline std::uint64_t monotonic_ns()
+  {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  struct size_class_stats
+  {
+    std::size_t objects_live, bytes_live;
+    std::size_t objects_freed, bytes_freed;
+
+    inline void merge(const size_class_stats& s)
+    {
+      objects_live += s.objects_live;
+      bytes_live += s.bytes_live;
+      objects_freed += s.objects_freed;
+      bytes_freed += s.bytes_freed;
+    }
+  };
+
+  struct heap_stats
+  {
+    size_class_stats small[impl_details::small_size_classes];
+    size_class_stats leaf[impl_details::small_size_classes];
+    size_class_stats medium[impl_details::medium_size_classes];
+    size_class_stats large;
+
+    inline void merge(const heap_stats& h)
+    {
+      for(std::size_t i = 0; i < impl_details::small_size_classes; ++i) {
+	small[i].merge(h.small[i]);
+	leaf[i].merge(h.leaf[i]);
+      }
+
+      for(std::size_t i = 0; i < impl_details::medium_size_classes; ++i)
+	medium[i].merge(h.medium[i]);
+
+      large.merge(h.large);
+    }
+
+    inline std::size_t live_bytes() const
+    {
+      std::size_t bytes = large.bytes_live;
+
+      for(std::size_t i = 0; i < impl_details::small_size_classes; ++i)
+	bytes += small[i].bytes_live + leaf[i].bytes_live;
+
+      for(std::size_t i = 0; i < impl_details::medium_size_classes; ++i)
+	bytes += medium[i].bytes_live;
+
+      return bytes;
+    }
+  };
+
+  struct gc_stats
+  {
+    std::uint64_t cycle;
+
+    // indexed by phase::phase_t; Sweep excludes the wait for the pacer.
+    std::uint64_t phase_ns[impl_details::phase_count];
+
+    // (mutator id, worst delay between a phase change and its handshake)
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> mutator_handshake_ns;
+    std::uint64_t max_handshake_ns;
+
+    // totals for the cycle, however many calls to step the tracing took.
+    // bytes_marked stays 0 unless the Tracer provides object_size.
+    std::size_t objects_marked, bytes_marked;
+
+    heap_stats heap;
+  };
+}
+#endif
@@ -2,6 +2,13 @@
 #define IMPL_DETAILS_HPP_INCLUDED
 
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define OTF_GC_ALWAYS_INLINE inline __attribute__((always_inline))
+#define OTF_GC_NOINLINE __attribute__((noinline, cold))
+#define OTF_GC_LIKELY(x) __builtin_expect(!!(x), 1)
+#define OTF_GC_UNLIKELY(x) __builtin_expect(!!(x), 0)
 
 namespace otf_gc
 {
@@ -21,24 +28,163 @@ namespace otf_gc
 
     static constexpr uint64_t header_tag_mask = ((1 << tag_bits) - 1) << color_bits;
     static constexpr uint64_t header_color_mask = 0x3;
+    static constexpr uint64_t header_leaf_bit = 1ULL << 63;
+    static constexpr uint64_t segment_shift_bits = 6;
+    static constexpr uint64_t header_segment_shift_offset = 63 - segment_shift_bits;
+    static constexpr uint64_t header_segment_shift_mask = ((1ULL << segment_shift_bits) - 1) << header_segment_shift_offset;
+    static constexpr uint64_t header_flags_mask = header_leaf_bit | header_segment_shift_mask;
     static constexpr std::size_t header_size = sizeof(header_t);
     static constexpr std::size_t log_ptr_size = sizeof(log_ptr_t);
     static constexpr std::size_t log_ptr_offset = 2*sizeof(std::size_t) + 2*sizeof(void*);
     static constexpr std::size_t search_depth = 32;
-    static constexpr std::size_t segment_size = 64; // size of a segment in bytes.
+    static constexpr std::size_t default_segment_shift = 6;
+    static constexpr std::size_t segment_size = 1ULL << default_segment_shift; // default size of a segment in bytes.
+    static constexpr std::size_t card_segment_shift = 12;
     static constexpr uint64_t small_block_metadata_size = header_size + log_ptr_size;
+    static constexpr uint64_t leaf_block_metadata_size = header_size;
     static constexpr uint64_t small_block_size_limit    = 6;
     static constexpr uint64_t split_bits                = 32;
     static constexpr uint64_t split_mask                = (1ULL << split_bits) - 1;
     static constexpr uint64_t split_switch_bits         = 32;
     static constexpr uint64_t split_switch_mask         = ((1ULL << split_switch_bits) - 1) << split_bits;    
-    static constexpr uint64_t large_block_metadata_size = 2*sizeof(void*) + header_size + sizeof(std::size_t);
+    static constexpr uint64_t large_block_metadata_size = 2*sizeof(void*) + header_size + 2*sizeof(std::size_t);
     static constexpr uint64_t large_obj_min_bits  = 10;
     static constexpr uint64_t large_obj_threshold = 1 << (large_obj_min_bits - 1);
+    static constexpr uint64_t medium_block_metadata_size = sizeof(std::size_t) + header_size;
+    static constexpr uint64_t medium_obj_min_bits = large_obj_min_bits;
+    static constexpr uint64_t medium_obj_max_bits = 15;
+    static constexpr uint64_t medium_obj_threshold = 1ULL << medium_obj_max_bits;
     static constexpr std::size_t mark_tick_frequency = 64;
+    static constexpr std::size_t default_marker_threads = 1;
+    static constexpr std::size_t collector_wait_timeout_us = 10000;
+    static constexpr std::size_t default_heap_growth_percent = 100;
+    static constexpr std::size_t min_pacing_trigger = 4ULL << 20;
+    static constexpr std::size_t alloc_flush_bytes = 64ULL << 10;
+    static constexpr std::size_t default_retained_memory_target = 64ULL << 20;
+    static constexpr std::size_t default_scavenge_rate_limit = 16ULL << 20;
+    static constexpr std::size_t steal_batch_size = 32;
+    static constexpr std::size_t mark_stack_chunk_size = 1024;
+    static constexpr std::size_t mark_segment_step = 64; // segments traced per visit to a large object.
+    static constexpr std::size_t scratch_arena_size = 64ULL << 10;
+    static constexpr std::size_t store_buffer_chunk_size = 1024;
+    static constexpr std::size_t snoop_buffer_chunk_size = 256;
+    static constexpr std::size_t snoop_filter_size = 64;
+    static constexpr std::size_t phase_count = 6;
+    static constexpr std::size_t pause_sub_bucket_bits = 5;
+    static constexpr std::size_t pause_max_exponent = 47;
+    static constexpr std::size_t pause_log_size = 1024;
     static constexpr std::size_t pool_chunk_size = 64;
-    static constexpr std::size_t small_size_classes = 7;
+    static constexpr std::size_t small_size_class_granularity = 16;
+    static constexpr std::size_t medium_class_bits = 2; // log2 of the medium size classes per doubling.
+    static constexpr std::size_t medium_size_classes = (medium_obj_max_bits - medium_obj_min_bits + 1) << medium_class_bits;
+    static constexpr std::size_t sweep_batch_size = 16;
     static constexpr std::size_t tick_frequency = 32;
+
+    // every Tracer and Policy hook is passed the header word as stored,
+    // colour and flags included. header_desc recovers the descriptor given
+    // to allocate, segment_shift and segment_bytes the object's segment size.
+    constexpr std::size_t segment_shift(underlying_header_t h)
+    {
+      return (h & header_segment_shift_mask) ? (h & header_segment_shift_mask) >> header_segment_shift_offset
+					     : default_segment_shift;
+    }
+
+    constexpr std::size_t segment_bytes(underlying_header_t h)
+    {
+      return 1ULL << segment_shift(h);
+    }
+
+    constexpr underlying_header_t header_desc(underlying_header_t h)
+    {
+      return (h & ~header_flags_mask) >> color_bits;
+    }
+
+    constexpr std::size_t next_small_size_class(std::size_t sz)
+    {
+      std::size_t pow2 = small_size_class_granularity;
+
+      while(2 * pow2 <= sz)
+	pow2 *= 2;
+
+      return sz < 4 * small_size_class_granularity
+	? sz + small_size_class_granularity
+	: sz + pow2 / 4;
+    }
+
+    constexpr std::size_t count_small_size_classes()
+    {
+      std::size_t n = 0;
+
+      for(std::size_t sz = small_size_class_granularity; sz <= large_obj_threshold; sz = next_small_size_class(sz))
+	++n;
+
+      return n;
+    }
+
+    static constexpr std::size_t small_size_classes = count_small_size_classes();
+
+    struct small_size_class_table
+    {
+      std::size_t size[small_size_classes];
+      std::uint8_t index[large_obj_threshold / small_size_class_granularity + 1];
+    };
+
+    constexpr small_size_class_table make_small_size_class_table()
+    {
+      small_size_class_table t{};
+      std::size_t n = 0;
+
+      for(std::size_t sz = small_size_class_granularity; sz <= large_obj_threshold; sz = next_small_size_class(sz))
+	t.size[n++] = sz;
+
+      for(std::size_t i = 0, c = 0; i <= large_obj_threshold / small_size_class_granularity; ++i) {
+	while(t.size[c] < i * small_size_class_granularity)
+	  ++c;
+
+	t.index[i] = static_cast<std::uint8_t>(c);
+      }
+
+      return t;
+    }
+
+    static constexpr small_size_class_table small_classes = make_small_size_class_table();
+
+    static_assert(small_classes.size[small_size_classes - 1] == large_obj_threshold,
+		  "the largest small size class must equal large_obj_threshold.");
+
+    // medium classes split each doubling above large_obj_threshold into
+    // 2^medium_class_bits evenly spaced sizes.
+    constexpr std::size_t medium_class_size(std::size_t i)
+    {
+      return (1ULL << ((i >> medium_class_bits) + medium_obj_min_bits - 1))
+	+ (((i & ((1ULL << medium_class_bits) - 1)) + 1) << ((i >> medium_class_bits) + medium_obj_min_bits - 1 - medium_class_bits));
+    }
+
+    constexpr std::size_t floor_log2(std::size_t sz)
+    {
+      return 63 - __builtin_clzll(sz);
+    }
+
+    constexpr std::size_t medium_size_class(std::size_t sz)
+    {
+      return ((floor_log2(sz - 1) - (medium_obj_min_bits - 1)) << medium_class_bits)
+	+ ((sz - 1 - (1ULL << floor_log2(sz - 1))) >> (floor_log2(sz - 1) - medium_class_bits));
+    }
+
+    static_assert(medium_class_size(0) > large_obj_threshold && medium_class_size(medium_size_classes - 1) == medium_obj_threshold,
+		  "the medium size classes must span (large_obj_threshold, medium_obj_threshold].");
+    static_assert(medium_size_class(large_obj_threshold + 1) == 0 && medium_size_class(medium_obj_threshold) == medium_size_classes - 1,
+		  "medium_size_class must invert medium_class_size.");
+
+    constexpr std::size_t small_size_class(std::size_t sz)
+    {
+      return small_classes.index[(sz + small_size_class_granularity - 1) / small_size_class_granularity];
+    }
+
+    constexpr std::size_t small_class_size(std::size_t i)
+    {
+      return small_classes.size[i];
+    }
   }
 }
 
@@ -13,19 +13,21 @@ namespace otf_gc
 
   struct block_cursor
   {
-    std::ptrdiff_t prev_d, next_d, log_ptr_d, header_d;
+    std::ptrdiff_t prev_d, next_d, size_d, log_ptr_d, header_d;
 
     block_cursor(void* blk, std::size_t num_log_ptrs = 0)
       : prev_d(reinterpret_cast<std::ptrdiff_t>(blk))
       , next_d(prev_d + sizeof(void*))
-      , log_ptr_d(next_d + sizeof(void*))
+      , size_d(next_d + sizeof(void*))
+      , log_ptr_d(size_d + sizeof(std::size_t))
       , header_d(log_ptr_d + sizeof(std::size_t) + log_ptr_size * num_log_ptrs)
     {}
 
     block_cursor(std::ptrdiff_t blk, std::size_t num_log_ptrs = 0)
       : prev_d(blk)
       , next_d(prev_d + sizeof(void*))
-      , log_ptr_d(next_d + sizeof(void*))
+      , size_d(next_d + sizeof(void*))
+      , log_ptr_d(size_d + sizeof(std::size_t))
       , header_d(log_ptr_d + sizeof(std::size_t) + log_ptr_size * num_log_ptrs)
     {}
 
@@ -54,11 +56,21 @@ namespace otf_gc
       return reinterpret_cast<header_t*>(header_d);
     }
 
+    inline std::size_t& size()
+    {
+      return *reinterpret_cast<std::size_t*>(size_d);
+    }
+
     inline std::size_t& num_log_ptrs()
     {
       return *reinterpret_cast<std::size_t*>(log_ptr_d);
     }
 
+    inline std::size_t segment_shift()
+    {
+      return impl_details::segment_shift(header()->load(std::memory_order_relaxed));
+    }
+
     inline void recalculate()
     {
       header_d = num_log_ptrs() * log_ptr_size + log_ptr_d + sizeof(std::size_t);
@@ -86,7 +98,8 @@ namespace otf_gc
     {
       prev_d = reinterpret_cast<std::ptrdiff_t>(blk);
       next_d = prev_d + sizeof(void*);
-      log_ptr_d = next_d + sizeof(void*);
+      size_d = next_d + sizeof(void*);
+      log_ptr_d = size_d + sizeof(std::size_t);
 
       if(blk)
 	recalculate();
@@ -0,0 +1,107 @@
+#ifndef MARK_STACK_HPP_INCLUDED
+#define MARK_STACK_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+#include "impl_details.hpp"
+
+namespace otf_gc
+{
+  class mark_stack
+  {
+  private:
+    struct chunk
+    {
+      chunk* prev;
+      void* entries[impl_details::mark_stack_chunk_size];
+    };
+
+    chunk* current;
+    chunk* spare;
+    std::size_t top, count;
+
+    OTF_GC_ALWAYS_INLINE void prefetch(void* p) const
+    {
+      using namespace impl_details;
+
+      auto hp = reinterpret_cast<std::uintptr_t>(p) - header_size;
+
+      __builtin_prefetch(reinterpret_cast<void*>(hp));
+      __builtin_prefetch(reinterpret_cast<void*>(hp - log_ptr_size));
+    }
+
+    OTF_GC_NOINLINE void push_chunk()
+    {
+      chunk* c = spare ? spare : new chunk;
+
+      spare = nullptr;
+      c->prev = current;
+      current = c;
+      top = 0;
+    }
+
+    OTF_GC_NOINLINE void pop_chunk()
+    {
+      delete spare;
+
+      spare = current;
+      current = current->prev;
+      top = impl_details::mark_stack_chunk_size;
+    }
+  public:
+    mark_stack()
+      : current(new chunk)
+      , spare(nullptr)
+      , top(0)
+      , count(0)
+    {
+      current->prev = nullptr;
+    }
+
+    mark_stack(const mark_stack&) = delete;
+    mark_stack& operator=(const mark_stack&) = delete;
+
+    ~mark_stack()
+    {
+      while(current) {
+	chunk* prev = current->prev;
+	delete current;
+	current = prev;
+      }
+
+      delete spare;
+    }
+
+    OTF_GC_ALWAYS_INLINE void push(void* p)
+    {
+      if(OTF_GC_UNLIKELY(top == impl_details::mark_stack_chunk_size))
+	push_chunk();
+
+      prefetch(p);
+
+      current->entries[top++] = p;
+      ++count;
+    }
+
+    OTF_GC_ALWAYS_INLINE void* pop()
+    {
+      if(OTF_GC_UNLIKELY(top == 0))
+	pop_chunk();
+
+      --count;
+      return current->entries[--top];
+    }
+
+    inline bool empty() const
+    {
+      return count == 0;
+    }
+
+    inline std::size_t size() const
+    {
+      return count;
+    }
+  };
+}
+#endif
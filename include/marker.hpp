@@ -3,10 +3,19 @@
 
 #include <atomic>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "atomic_list.hpp"
+#include "gc_stats.hpp"
 #include "impl_details.hpp"
 #include "large_block_list.hpp"
+#include "mark_stack.hpp"
+#include "scratch_arena.hpp"
+#include "store_buffer.hpp"
+#include "tracer_adapter.hpp"
+#include "worker_pool.hpp"
 
 namespace otf_gc
 {
@@ -14,8 +23,31 @@ namespace otf_gc
   class marker
   {
   private:
-    list<void*> roots;
+    using visitor_tracer = visiting_tracer<Tracer>;
+    using copier = snapshot_copier<Tracer>;
+    using sizer = object_sizer<Tracer>;
+
+    struct mark_deque
+    {
+      mark_stack local, shared;
+      scratch_arena scratch;
+      std::atomic<std::size_t> shared_size;
+      std::mutex steal_mut;
+
+      mark_deque() : shared_size(0) {}
+    };
+
+    std::size_t num_workers;
+    std::unique_ptr<mark_deque[]> deques;
+    std::atomic<std::size_t> idle, marked, marked_bytes;
+    std::atomic<bool> bailout;
     std::atomic<bool>& running;
+    std::uint64_t deadline_ns;
+
+    inline bool preempted() const
+    {
+      return !running.load(std::memory_order_relaxed) || (deadline_ns && monotonic_ns() >= deadline_ns);
+    }
     
     inline uint64_t set_color(impl_details::underlying_header_t header, color c)
     {
@@ -30,107 +62,335 @@ namespace otf_gc
       return *reinterpret_cast<impl_details::header_t*>(pr);
     }
 
-    inline void clear_copy(void* buf)
+    static constexpr std::uintptr_t continuation_bit = 1;
+    static constexpr std::size_t continuation_shift = 48;
+    static constexpr std::uintptr_t continuation_addr_mask = (1ULL << continuation_shift) - 1;
+
+    // a (object, next segment) continuation fits in one mark stack entry:
+    // the segment is stored in units of segment_step() in the otherwise
+    // unused top bits, the low bit tags the entry.
+    inline std::size_t segment_step(std::size_t num_log_ptrs)
     {
-      if(!buf) return;
-      
-      header_t* hp = reinterpret_cast<header_t*>(reinterpret_cast<std::ptrdiff_t>(buf) - header_size);
-      hp->~header_t();
+      std::size_t step = (num_log_ptrs >> (64 - continuation_shift)) + 1;
+      return step < impl_details::mark_segment_step ? impl_details::mark_segment_step : step;
+    }
+
+    inline void* continuation(void* root, std::size_t step_num)
+    {
+      auto rp = reinterpret_cast<std::uintptr_t>(root);
       
-      free(reinterpret_cast<void*>(hp));      
+      assert((rp & ~continuation_addr_mask) == 0);
+      return reinterpret_cast<void*>(rp | (step_num << continuation_shift) | continuation_bit);
     }
-    
-    inline void mark_indiv(void* root, const color& c)
+
+    inline void mark_segment(impl_details::underlying_header_t header_c,
+			     void* root,
+			     impl_details::log_ptr_t* lp,
+			     std::size_t obj_seg,
+			     mark_stack& roots,
+			     scratch_arena& scratch)
+    {
+      bool dirtied = false;
+	  
+      if(lp->load() == nullptr) {
+	void* buf = copier::copy_obj_segment(header_c, root, obj_seg, scratch);
+	      
+	if(lp->load() == nullptr && buf)
+	  visitor_tracer::visit_segment(header_c, buf, obj_seg, roots);
+	else
+	  dirtied = true;
+
+	copier::release(buf, scratch);
+      } else {
+	dirtied = true;
+      }
+	  
+      if(dirtied) {
+	auto lpp = lp->load();
+	    
+	if(lpp) {
+	  void** rec = reinterpret_cast<void**>(lpp);
+	  assert((reinterpret_cast<std::ptrdiff_t>(rec[0]) & 1ULL) != 0ULL);
+
+	  void** children = store_buffer::record_children(rec);
+
+	  for(std::size_t i = 0; i < store_buffer::record_count(rec); ++i)
+	    if(children[i])
+	      roots.push(children[i]);
+	}
+      }
+    }
+
+    inline bool mark_indiv(void* root, const color& c, mark_stack& roots, scratch_arena& scratch, std::size_t& bytes)
     {
       using namespace impl_details;
+
+      std::size_t step_num = 0;
+      auto rp = reinterpret_cast<std::uintptr_t>(root);
+      bool claimed = rp & continuation_bit;
+
+      if(claimed) {
+	step_num = rp >> continuation_shift;
+	rp &= continuation_addr_mask & ~continuation_bit;
+	root = reinterpret_cast<void*>(rp);
+      }
       
       header_t& header_w = header(root);
       underlying_header_t header_c = header_w.load(std::memory_order_relaxed);
+      color hc(header_c & header_color_mask);
 
-      if(color(header_c & header_color_mask) != c)
+      if(claimed || (hc != c && hc.c != color::color_t::Grey))
       {
-	size_t num_log_ptrs = Tracer::num_log_ptrs(header_c);
+	if(header_c & header_leaf_bit) {
+	  header_w.store(set_color(header_c, c), std::memory_order_relaxed);
+	  bytes += sizer::size(header_c);
+	  return true;
+	}
 
-	auto rp = reinterpret_cast<std::size_t>(root);
+	size_t num_log_ptrs = Tracer::num_log_ptrs(header_c);
 
 	if(num_log_ptrs == 0) {
-	  void* buf = Tracer::copy_obj(header_c, root);
+	  void* buf = copier::copy_obj(header_c, root, scratch);
 
 	  if(buf)
-	    roots.append(Tracer::get_derived_ptrs(header_c, buf));
+	    visitor_tracer::visit_obj(header_c, buf, roots);
 
-	  clear_copy(buf);
-	} else {		  	
-	  std::size_t rp_start = rp - header_size - num_log_ptrs * log_ptr_size;	
-	
-	  for(std::size_t p = rp_start; p < rp - header_size; p += log_ptr_size)
-	  {
-	    bool dirtied = false;
-	    log_ptr_t* lp = reinterpret_cast<log_ptr_t*>(p);	  
+	  copier::release(buf, scratch);
+	} else {
+	  std::size_t step = segment_step(num_log_ptrs);
+	  std::size_t first_seg = step_num * step;
+	  std::size_t last_seg = first_seg + step;
 	  
-	    if(lp->load() == nullptr) {
-	      std::size_t obj_seg = (p - rp_start) / log_ptr_size;	    
-	      void* buf = Tracer::copy_obj_segment(header_c, root, obj_seg);
-	      
-	      if(lp->load() == nullptr && buf)
-		roots.append(Tracer::derived_ptrs_of_obj_segment(header_c, buf, obj_seg));
-	      else
-		dirtied = true;	    
-
-	      clear_copy(buf);
-	    } else {
-	      dirtied = true;
-	    }
+	  // the colour may only change once every segment has been traced,
+	  // else the barrier would stop logging the segments still pending.
+	  // meanwhile the object is grey, and its first visitor owns the
+	  // chain of continuations; later visitors find it grey and return.
+	  if(!claimed && last_seg < num_log_ptrs
+	     && !header_w.compare_exchange_strong(header_c, set_color(header_c, color::color_t::Grey),
+						  std::memory_order_relaxed))
+	    return false;
+
+	  if(last_seg < num_log_ptrs)
+	    roots.push(continuation(root, step_num + 1));
+	  else
+	    last_seg = num_log_ptrs;
 	  
-	    if(dirtied) {
-	      auto lpp = lp->load();
-	    
-	      if(lpp) {
-		list<void*> buffer_list(reinterpret_cast<typename list<void*>::node_type*>(lpp));	      	      
-		auto it = buffer_list.begin();
-		
-		if(it != buffer_list.end() && *it)
-		{
-		  assert((reinterpret_cast<std::ptrdiff_t>(*it) & 1ULL) != 0ULL);
-		    
-		  ++it;
-		
-		  for(; it != buffer_list.end(); ++it) {
-		    if(!(*it)) continue;
-		    
-		    if((reinterpret_cast<std::ptrdiff_t>(*it) & 1ULL) != 0ULL)
-		      break;
-		    else 
-		      roots.push_front(*it);
-		  }
-		}
-	      }
-	    }
-	  }
+	  std::size_t rp_start = rp - header_size - num_log_ptrs * log_ptr_size;	
+	
+	  for(std::size_t seg = first_seg; seg < last_seg; ++seg)
+	    mark_segment(header_c, root, reinterpret_cast<log_ptr_t*>(rp_start + seg * log_ptr_size), seg, roots, scratch);
+
+	  if(last_seg < num_log_ptrs)
+	    return false;
 	}
 
 	header_w.store(set_color(header_c, c), std::memory_order_relaxed);
+	bytes += sizer::size(header_c);
+	return true;
       } else {
-	assert(color(header_c & header_color_mask) == c);
-      }            
-    }  
-  public:
-    marker(list<void*>&& roots_, std::atomic<bool>& running_)
-      : roots(std::move(roots_)), running(running_)
-    {}
+	assert(hc == c || hc.c == color::color_t::Grey);
+	return false;
+      }
+    }
     
-    inline void mark(const color& ep)
+    inline void publish(mark_deque& d)
     {
-      size_t ticks = 0;
-      
-      while(!roots.empty()) {	  	  
-	void* root = roots.front();
-	roots.pop_front();
-	
-	if(root) mark_indiv(root, ep);
-	if(++ticks % impl_details::mark_tick_frequency == 0 && !running.load(std::memory_order_relaxed))
-	  break;
-      }      
+      std::lock_guard<std::mutex> lk(d.steal_mut);
+      std::size_t moved = 0;
+
+      while(moved < impl_details::steal_batch_size && d.local.size() > 1) {
+	d.shared.push(d.local.pop());
+	++moved;
+      }
+
+      d.shared_size.store(moved, std::memory_order_relaxed);
+    }
+
+    inline bool take_shared(mark_deque& d)
+    {
+      if(d.shared_size.load(std::memory_order_relaxed) == 0)
+	return false;
+
+      std::lock_guard<std::mutex> lk(d.steal_mut);
+
+      while(!d.shared.empty())
+	d.local.push(d.shared.pop());
+
+      d.shared_size.store(0, std::memory_order_relaxed);
+
+      return !d.local.empty();
+    }
+
+    bool steal(std::size_t id)
+    {
+      for(std::size_t i = 1; i < num_workers; ++i)
+      {
+	mark_deque& victim = deques[(id + i) % num_workers];
+
+	if(victim.shared_size.load(std::memory_order_relaxed) == 0)
+	  continue;
+
+	std::lock_guard<std::mutex> lk(victim.steal_mut);
+	std::size_t sz = victim.shared_size.load(std::memory_order_relaxed);
+	std::size_t taken = (sz + 1) / 2;
+
+	for(std::size_t j = 0; j < taken; ++j)
+	  deques[id].local.push(victim.shared.pop());
+
+	victim.shared_size.store(sz - taken, std::memory_order_relaxed);
+
+	if(taken > 0)
+	  return true;
+      }
+
+      return false;
+    }
+
+    inline bool work_available(std::size_t id)
+    {
+      for(std::size_t i = 1; i < num_workers; ++i)
+	if(deques[(id + i) % num_workers].shared_size.load(std::memory_order_relaxed) > 0)
+	  return true;
+
+      return false;
+    }
+
+    void work(std::size_t id, const color& ep)
+    {
+      std::size_t count = 0, bytes = 0;
+
+      work(id, ep, count, bytes);
+      marked.fetch_add(count, std::memory_order_relaxed);
+      marked_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void work(std::size_t id, const color& ep, std::size_t& count, std::size_t& bytes)
+    {
+      mark_deque& d = deques[id];
+      std::size_t ticks = 0;
+
+      while(true)
+      {
+	while(!d.local.empty() || take_shared(d))
+	{
+	  void* root = d.local.pop();
+
+	  if(root && mark_indiv(root, ep, d.local, d.scratch, bytes))
+	    ++count;
+
+	  if(++ticks % impl_details::mark_tick_frequency == 0) {
+	    if(preempted())
+	      bailout.store(true, std::memory_order_relaxed);
+
+	    if(bailout.load(std::memory_order_relaxed))
+	      return;
+	  }
+
+	  if(num_workers > 1 && idle.load(std::memory_order_relaxed) > 0
+	     && d.shared_size.load(std::memory_order_relaxed) == 0 && !d.local.empty())
+	    publish(d);
+	}
+
+	if(num_workers > 1 && steal(id))
+	  continue;
+
+	idle.fetch_add(1, std::memory_order_acq_rel);
+
+	while(true)
+	{
+	  if(idle.load(std::memory_order_acquire) == num_workers || bailout.load(std::memory_order_relaxed))
+	    return;
+
+	  if(preempted()) {
+	    bailout.store(true, std::memory_order_relaxed);
+	    return;
+	  }
+
+	  if(work_available(id)) {
+	    idle.fetch_sub(1, std::memory_order_acq_rel);
+	    break;
+	  }
+
+	  std::this_thread::yield();
+	}
+      }
+    }
+  public:
+    marker(list<void*>&& roots_,
+	   store_buffer_chunk* snooped,
+	   std::atomic<bool>& running_,
+	   std::size_t num_workers_ = 1)
+      : num_workers(num_workers_)
+      , deques(new mark_deque[num_workers_])
+      , idle(0)
+      , marked(0)
+      , marked_bytes(0)
+      , bailout(false)
+      , running(running_)
+      , deadline_ns(0)
+    {
+      std::size_t i = 0;
+
+      for(; !roots_.empty(); i = (i + 1) % num_workers) {
+	deques[i].local.push(roots_.front());
+	roots_.pop_front();
+      }
+
+      while(snooped) {
+	for(std::size_t j = 0; j < snooped->used; ++j, i = (i + 1) % num_workers)
+	  deques[i].local.push(snooped->slots[j]);
+
+	store_buffer_chunk* next = snooped->next;
+	store_buffer_chunk::destroy(snooped);
+	snooped = next;
+      }
+    }
+
+    inline std::size_t mark(const color& ep)
+    {
+      assert(num_workers == 1);
+      work(0, ep);
+
+      return marked.load(std::memory_order_relaxed);
+    }
+
+    inline std::size_t mark(const color& ep, worker_pool& workers)
+    {
+      assert(num_workers == workers.size());
+      workers.run([this, &ep](std::size_t id) { work(id, ep); });
+
+      return marked.load(std::memory_order_relaxed);
+    }
+
+    // marks until deadline (in monotonic_ns), leaving the deques intact
+    // so that a later call resumes where this one stopped.
+    inline std::size_t mark(const color& ep, worker_pool& workers, std::uint64_t deadline)
+    {
+      deadline_ns = deadline;
+      idle.store(0, std::memory_order_relaxed);
+      bailout.store(false, std::memory_order_relaxed);
+
+      return mark(ep, workers);
+    }
+
+    // both counts run over the marker's lifetime, ie. the whole cycle.
+    inline std::size_t objects_marked() const
+    {
+      return marked.load(std::memory_order_relaxed);
+    }
+
+    inline std::size_t bytes_marked() const
+    {
+      return marked_bytes.load(std::memory_order_relaxed);
+    }
+
+    inline bool finished() const
+    {
+      for(std::size_t i = 0; i < num_workers; ++i)
+	if(!deques[i].local.empty() || !deques[i].shared.empty())
+	  return false;
+
+      return true;
     }
   };
 }
@@ -2,11 +2,15 @@
 #define MUTATOR_HPP_INCLUDED
 
 #include <array>
+#include <utility>
 
 #include "atomic_list.hpp"
+#include "block_layout.hpp"
 #include "color.hpp"
 #include "fixed_list_manager.hpp"
+#include "free_span_list.hpp"
 #include "large_block_list.hpp"
+#include "pause_stats.hpp"
 
 namespace otf_gc
 {
@@ -14,34 +18,188 @@ namespace otf_gc
   {
   protected:
     std::array<fixed_list_manager, impl_details::small_size_classes> fixed_managers;
+    std::array<fixed_list_manager, impl_details::small_size_classes> leaf_managers;
+    std::array<fixed_list_manager, impl_details::medium_size_classes> medium_managers;
     large_block_list large_used_list;
     list<void*> allocation_dump;
     color alloc_color;
+    std::size_t bytes_allocated;
 
-    inline impl_details::underlying_header_t create_header(impl_details::underlying_header_t);    
-    inline bool transfer_small_blocks_from_collector(size_t);
-    
-    void* allocate_small(size_t, impl_details::underlying_header_t);
+    static constexpr std::uint8_t sync_requested_bit = 1;
+    static constexpr std::uint8_t barrier_on_bit = 2;
+
+    // the collector sets sync_requested_bit on a phase change; the
+    // registered mutator keeps its barrier state beside it, so the write
+    // barrier's fast path tests both with a single load.
+    std::atomic<std::uint8_t> sync_word;
+
+    pause_recorder pause_rec;
+
+    OTF_GC_ALWAYS_INLINE impl_details::underlying_header_t create_header(impl_details::underlying_header_t desc)
+    {
+      using namespace impl_details;
+
+      // the descriptor must not reach the segment shift and leaf flags.
+      assert((desc >> (header_segment_shift_offset - color_bits)) == 0);
+      return static_cast<underlying_header_t>(alloc_color.c) | (desc << color_bits);
+    }
+
+    OTF_GC_ALWAYS_INLINE impl_details::underlying_header_t create_segmented_header(impl_details::underlying_header_t desc,
+									     std::size_t segment_shift)
+    {
+      using namespace impl_details;
+
+      assert(segment_shift < (1ULL << segment_shift_bits));
+      return create_header(desc) | (static_cast<underlying_header_t>(segment_shift) << header_segment_shift_offset);
+    }
+
+    OTF_GC_ALWAYS_INLINE impl_details::underlying_header_t create_leaf_header(impl_details::underlying_header_t desc)
+    {
+      return create_header(desc) | impl_details::header_leaf_bit;
+    }
+
+    inline void* get_fixed_block(fixed_list_manager&, free_span_list&, atomic_list<stub_list>&);
+    inline void count_allocation(std::size_t);
+    void flush_allocation_count();
+
+    // handshakes if the collector has moved on, at the allocation slow
+    // paths. implemented by gc::registered_mutator.
+    virtual void safepoint() = 0;
+
+    OTF_GC_NOINLINE void* allocate_small_slow(size_t, impl_details::underlying_header_t);
+    OTF_GC_NOINLINE void* allocate_slow(size_t, impl_details::underlying_header_t, size_t, size_t);
+    OTF_GC_NOINLINE void* allocate_leaf_small_slow(size_t, impl_details::underlying_header_t);
+    OTF_GC_NOINLINE void* allocate_leaf_slow(size_t, impl_details::underlying_header_t);
+
+    void* allocate_medium(size_t, impl_details::underlying_header_t, size_t);
     void* allocate_large(size_t, impl_details::underlying_header_t, size_t);
 
+    OTF_GC_ALWAYS_INLINE void* allocate_small(size_t size_class, impl_details::underlying_header_t desc)
+    {
+      using namespace impl_details;
+
+      void* p = fixed_managers[size_class].bump();
+
+      if(OTF_GC_UNLIKELY(!p))
+	return allocate_small_slow(size_class, desc);
+
+      small_layout::initialize(reinterpret_cast<std::uint64_t>(p), create_header(desc), 1);
+
+      return reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(p) + small_block_metadata_size);
+    }
+
+    OTF_GC_ALWAYS_INLINE void* allocate_leaf_small(size_t size_class, impl_details::underlying_header_t desc)
+    {
+      using namespace impl_details;
+
+      void* p = leaf_managers[size_class].bump();
+
+      if(OTF_GC_UNLIKELY(!p))
+	return allocate_leaf_small_slow(size_class, desc);
+
+      leaf_layout::initialize(reinterpret_cast<std::uint64_t>(p), create_leaf_header(desc), 0);
+
+      return reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(p) + leaf_block_metadata_size);
+    }
+
+    template <std::size_t... Is>
+    static std::array<fixed_list_manager, sizeof...(Is)> make_small_managers(std::index_sequence<Is...>)
+    {
+      return {{fixed_list_manager(impl_details::small_class_size(Is))...}};
+    }
+
+    template <std::size_t... Is>
+    static std::array<fixed_list_manager, sizeof...(Is)> make_medium_managers(std::index_sequence<Is...>)
+    {
+      return {{fixed_list_manager(impl_details::medium_class_size(Is))...}};
+    }
+
     mutator(color c)
-      : fixed_managers{{fixed_list_manager(3)
-	  , fixed_list_manager(4)
-	  , fixed_list_manager(5)
-	  , fixed_list_manager(6)
-	  , fixed_list_manager(7)
-	  , fixed_list_manager(8)
-	  , fixed_list_manager(9)}}
+      : fixed_managers(make_small_managers(std::make_index_sequence<impl_details::small_size_classes>()))
+      , leaf_managers(make_small_managers(std::make_index_sequence<impl_details::small_size_classes>()))
+      , medium_managers(make_medium_managers(std::make_index_sequence<impl_details::medium_size_classes>()))
       , alloc_color(c)
+      , bytes_allocated(0)
+      , sync_word(0)
     {}
   public:
     virtual ~mutator() {}
 
-    inline static size_t binary_log(int);
+    OTF_GC_ALWAYS_INLINE bool sync_requested() const
+    {
+      return sync_word.load(std::memory_order_relaxed) & sync_requested_bit;
+    }
+
+    inline pause_recorder& pauses()
+    {
+      return pause_rec;
+    }
+
+    OTF_GC_ALWAYS_INLINE void* allocate(int raw_sz,
+					impl_details::underlying_header_t desc,
+					size_t num_log_ptrs,
+					size_t segment_shift = 0)
+    {
+      using namespace impl_details;
+
+      if(OTF_GC_LIKELY(raw_sz + small_block_metadata_size <= large_obj_threshold)) {
+	// small objects are traced and logged as a single segment.
+	assert(segment_shift == 0);
+	return allocate_small(small_size_class(raw_sz + small_block_metadata_size), desc);
+      }
+
+      return allocate_slow(raw_sz, desc, num_log_ptrs, segment_shift);
+    }
+
+    template <std::size_t N>
+    OTF_GC_ALWAYS_INLINE void* allocate(impl_details::underlying_header_t desc,
+					size_t num_log_ptrs,
+					size_t segment_shift = 0)
+    {
+      using namespace impl_details;
+
+      constexpr bool small = N + small_block_metadata_size <= large_obj_threshold;
+      constexpr std::size_t size_class = small_size_class(small ? N + small_block_metadata_size : 0);
+
+      if(small) {
+	assert(segment_shift == 0);
+	return allocate_small(size_class, desc);
+      }
+
+      return allocate_slow(N, desc, num_log_ptrs, segment_shift);
+    }
+
+    OTF_GC_ALWAYS_INLINE void* allocate_leaf(int raw_sz, impl_details::underlying_header_t desc)
+    {
+      using namespace impl_details;
+
+      if(OTF_GC_LIKELY(raw_sz + leaf_block_metadata_size <= large_obj_threshold))
+	return allocate_leaf_small(small_size_class(raw_sz + leaf_block_metadata_size), desc);
+
+      return allocate_leaf_slow(raw_sz, desc);
+    }
+
+    template <std::size_t N>
+    OTF_GC_ALWAYS_INLINE void* allocate_leaf(impl_details::underlying_header_t desc)
+    {
+      using namespace impl_details;
+
+      constexpr bool small = N + leaf_block_metadata_size <= large_obj_threshold;
+      constexpr std::size_t size_class = small_size_class(small ? N + leaf_block_metadata_size : 0);
+
+      if(small)
+	return allocate_leaf_small(size_class, desc);
+
+      return allocate_leaf_slow(N, desc);
+    }
 
-    void* allocate(int, impl_details::underlying_header_t, size_t);
+    // moves what has been bumped into the used lists, so that the used
+    // list handoff needn't allocate.
+    void flush_used_spans();
 
     stub_list vacate_small_used_list(size_t);
+    stub_list vacate_leaf_used_list(size_t);
+    stub_list vacate_medium_used_list(size_t);
     large_block_list vacate_large_used_list();
   };
 }
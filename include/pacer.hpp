@@ -0,0 +1,82 @@
+#ifndef PACER_HPP_INCLUDED
+#define PACER_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#include "impl_details.hpp"
+
+namespace otf_gc
+{
+  class pacer
+  {
+  private:
+    std::atomic<std::size_t> allocated, live, trigger;
+    std::atomic<std::size_t> growth_percent;
+    std::atomic<bool> requested;
+
+    inline std::size_t compute_trigger(std::size_t live_bytes) const
+    {
+      std::size_t growth = live_bytes / 100 * growth_percent.load(std::memory_order_relaxed);
+      return std::max(growth, impl_details::min_pacing_trigger);
+    }
+  public:
+    pacer()
+      : allocated(0)
+      , live(0)
+      , trigger(impl_details::min_pacing_trigger)
+      , growth_percent(impl_details::default_heap_growth_percent)
+      , requested(false)
+    {}
+
+    inline bool note_allocation(std::size_t bytes)
+    {
+      std::size_t prev = allocated.fetch_add(bytes, std::memory_order_relaxed);
+      std::size_t tr = trigger.load(std::memory_order_relaxed);
+
+      return prev < tr && prev + bytes >= tr;
+    }
+
+    inline bool cycle_due() const
+    {
+      return growth_percent.load(std::memory_order_relaxed) == 0
+	|| requested.load(std::memory_order_relaxed)
+	|| allocated.load(std::memory_order_relaxed) >= trigger.load(std::memory_order_relaxed);
+    }
+
+    inline void request_cycle()
+    {
+      requested.store(true, std::memory_order_relaxed);
+    }
+
+    inline void begin_cycle()
+    {
+      requested.store(false, std::memory_order_relaxed);
+      allocated.store(0, std::memory_order_relaxed);
+    }
+
+    inline void end_cycle(std::size_t live_bytes)
+    {
+      live.store(live_bytes, std::memory_order_relaxed);
+      trigger.store(compute_trigger(live_bytes), std::memory_order_relaxed);
+    }
+
+    inline void set_growth_percent(std::size_t percent)
+    {
+      growth_percent.store(percent, std::memory_order_relaxed);
+      trigger.store(compute_trigger(live.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+    }
+
+    inline std::size_t live_bytes() const
+    {
+      return live.load(std::memory_order_relaxed);
+    }
+
+    inline std::size_t allocated_bytes() const
+    {
+      return allocated.load(std::memory_order_relaxed);
+    }
+  };
+}
+#endif
@@ -0,0 +1,311 @@
+#ifndef PAUSE_STATS_HPP_INCLUDED
+#define PAUSE_STATS_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gc_stats.hpp"
+#include "impl_details.hpp"
+
+namespace otf_gc
+{
+  struct pause_summary
+  {
+    std::uint64_t count, total_ns;
+    std::uint64_t p50_ns, p99_ns, p999_ns, max_ns;
+  };
+
+  struct mmu_point
+  {
+    std::uint64_t window_ns;
+    double utilization;
+
+    // false when no mutator's pause log spans a whole window, in which
+    // case utilization is meaningless.
+    bool available;
+  };
+
+  struct pause_report
+  {
+    pause_summary handshake, allocation, barrier, all;
+
+    // the worst utilization over all live mutators, one point per window.
+    std::vector<mmu_point> mmu;
+  };
+
+  struct pause_event
+  {
+    std::uint64_t start_ns, duration_ns;
+  };
+
+  // log-linear buckets in the style of HDR histograms: exact below
+  // 2^pause_sub_bucket_bits ns, then 2^(pause_sub_bucket_bits-1) buckets
+  // per power of two. written by one thread, read by any.
+  class pause_histogram
+  {
+  private:
+    static constexpr std::size_t sub_bits = impl_details::pause_sub_bucket_bits;
+    static constexpr std::size_t exact = 1ULL << sub_bits;
+    static constexpr std::size_t half = exact / 2;
+    static constexpr std::size_t max_exp = impl_details::pause_max_exponent;
+    static constexpr std::size_t num_buckets = exact + (max_exp - sub_bits + 1) * half;
+
+    std::atomic<std::uint64_t> counts[num_buckets];
+    std::atomic<std::uint64_t> total, max;
+
+    static inline std::size_t bucket(std::uint64_t ns)
+    {
+      if(ns < exact)
+	return ns;
+
+      std::size_t e = 63 - __builtin_clzll(ns);
+
+      if(e > max_exp)
+	return num_buckets - 1;
+
+      return exact + (e - sub_bits) * half + ((ns >> (e - sub_bits + 1)) - half);
+    }
+
+    static inline std::uint64_t bucket_limit(std::size_t i)
+    {
+      if(i < exact)
+	return i;
+
+      std::size_t k = i - exact;
+      std::size_t e = k / half + sub_bits;
+
+      return ((k % half + half + 1) << (e - sub_bits + 1)) - 1;
+    }
+
+    static inline void add(std::atomic<std::uint64_t>& c, std::uint64_t v)
+    {
+      c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+  public:
+    pause_histogram() : total(0), max(0)
+    {
+      for(auto& c : counts)
+	c.store(0, std::memory_order_relaxed);
+    }
+
+    pause_histogram(const pause_histogram&) = delete;
+    pause_histogram& operator=(const pause_histogram&) = delete;
+
+    inline void record(std::uint64_t ns)
+    {
+      add(counts[bucket(ns)], 1);
+      add(total, ns);
+
+      if(ns > max.load(std::memory_order_relaxed))
+	max.store(ns, std::memory_order_relaxed);
+    }
+
+    // the caller must be the only writer of this histogram.
+    void merge(const pause_histogram& h)
+    {
+      for(std::size_t i = 0; i < num_buckets; ++i)
+	add(counts[i], h.counts[i].load(std::memory_order_relaxed));
+
+      add(total, h.total.load(std::memory_order_relaxed));
+      max.store(std::max(max.load(std::memory_order_relaxed), h.max.load(std::memory_order_relaxed)),
+		std::memory_order_relaxed);
+    }
+
+    pause_summary summary() const
+    {
+      pause_summary s{};
+
+      for(std::size_t i = 0; i < num_buckets; ++i)
+	s.count += counts[i].load(std::memory_order_relaxed);
+
+      s.total_ns = total.load(std::memory_order_relaxed);
+      s.max_ns = max.load(std::memory_order_relaxed);
+
+      std::uint64_t* targets[] = { &s.p50_ns, &s.p99_ns, &s.p999_ns };
+      const std::uint64_t ranks[] = { (s.count * 500 + 999) / 1000,
+				      (s.count * 990 + 999) / 1000,
+				      (s.count * 999 + 999) / 1000 };
+
+      std::uint64_t seen = 0;
+
+      for(std::size_t i = 0, t = 0; i < num_buckets && t < 3; ++i) {
+	seen += counts[i].load(std::memory_order_relaxed);
+
+	for(; t < 3 && ranks[t] <= seen; ++t)
+	  *targets[t] = std::min(bucket_limit(i), s.max_ns);
+      }
+
+      return s;
+    }
+  };
+
+  // the last pause_log_size pauses of one thread, for MMU curves.
+  class pause_log
+  {
+  private:
+    struct entry
+    {
+      std::atomic<std::uint64_t> start_ns, duration_ns;
+    };
+
+    entry events[impl_details::pause_log_size];
+    std::atomic<std::uint64_t> head, reserved;
+    std::uint64_t created_ns;
+  public:
+    pause_log() : head(0), reserved(0), created_ns(monotonic_ns()) {}
+
+    pause_log(const pause_log&) = delete;
+    pause_log& operator=(const pause_log&) = delete;
+
+    inline void record(std::uint64_t start_ns, std::uint64_t duration_ns)
+    {
+      std::uint64_t h = head.load(std::memory_order_relaxed);
+      entry& e = events[h % impl_details::pause_log_size];
+
+      reserved.store(h + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      e.start_ns.store(start_ns, std::memory_order_relaxed);
+      e.duration_ns.store(duration_ns, std::memory_order_relaxed);
+
+      head.store(h + 1, std::memory_order_release);
+    }
+
+    // begin_ns is set to the start of the span the snapshot covers.
+    std::vector<pause_event> snapshot(std::uint64_t& begin_ns) const
+    {
+      using namespace impl_details;
+
+      std::uint64_t h = head.load(std::memory_order_acquire);
+      std::uint64_t first = h > pause_log_size ? h - pause_log_size : 0;
+
+      std::vector<pause_event> result;
+      result.reserve(h - first);
+
+      for(std::uint64_t i = first; i < h; ++i) {
+	const entry& e = events[i % pause_log_size];
+	result.push_back({ e.start_ns.load(std::memory_order_relaxed), e.duration_ns.load(std::memory_order_relaxed) });
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      // drop the entries the writer may have overwritten while we copied.
+      std::uint64_t r = reserved.load(std::memory_order_relaxed);
+      std::uint64_t stale = r > first + pause_log_size ? r - first - pause_log_size : 0;
+
+      stale = std::min<std::uint64_t>(stale, result.size());
+      result.erase(result.begin(), result.begin() + stale);
+
+      begin_ns = (first + stale == 0) ? created_ns : (result.empty() ? monotonic_ns() : result.front().start_ns);
+
+      return result;
+    }
+  };
+
+  struct pause_histograms
+  {
+    pause_histogram handshake, allocation, barrier;
+
+    inline void merge(const pause_histograms& h)
+    {
+      handshake.merge(h.handshake);
+      allocation.merge(h.allocation);
+      barrier.merge(h.barrier);
+    }
+  };
+
+  struct pause_recorder
+  {
+    pause_histograms histograms;
+    pause_log log;
+
+    inline void record(pause_histogram& h, std::uint64_t start_ns)
+    {
+      std::uint64_t duration = monotonic_ns() - start_ns;
+
+      h.record(duration);
+      log.record(start_ns, duration);
+    }
+  };
+
+  class pause_timer
+  {
+  private:
+    pause_recorder& recorder;
+    pause_histogram& histogram;
+    std::uint64_t start_ns;
+  public:
+    pause_timer(pause_recorder& recorder_, pause_histogram& histogram_)
+      : recorder(recorder_)
+      , histogram(histogram_)
+      , start_ns(monotonic_ns())
+    {}
+
+    pause_timer(const pause_timer&) = delete;
+    pause_timer& operator=(const pause_timer&) = delete;
+
+    ~pause_timer()
+    {
+      recorder.record(histogram, start_ns);
+    }
+  };
+
+  // the smallest fraction of any window_ns long window in [begin_ns, end_ns)
+  // left to the mutator, given its sorted, disjoint pauses. the window must
+  // fit in the span.
+  inline double minimum_mutator_utilization(const std::vector<pause_event>& pauses,
+					    std::uint64_t window_ns,
+					    std::uint64_t begin_ns,
+					    std::uint64_t end_ns)
+  {
+    assert(begin_ns + window_ns <= end_ns);
+
+    if(window_ns == 0)
+      return 1.0;
+
+    std::vector<std::uint64_t> cumulative(pauses.size() + 1, 0);
+
+    for(std::size_t i = 0; i < pauses.size(); ++i)
+      cumulative[i+1] = cumulative[i] + pauses[i].duration_ns;
+
+    auto paused = [&](std::uint64_t a, std::uint64_t b) -> std::uint64_t {
+      auto i = std::partition_point(pauses.begin(), pauses.end(), [a](const pause_event& p) {
+	  return p.start_ns + p.duration_ns <= a;
+	}) - pauses.begin();
+      auto j = std::partition_point(pauses.begin(), pauses.end(), [b](const pause_event& p) {
+	  return p.start_ns < b;
+	}) - pauses.begin();
+
+      if(i >= j)
+	return 0;
+
+      std::uint64_t sum = cumulative[j] - cumulative[i];
+
+      if(pauses[i].start_ns < a)
+	sum -= a - pauses[i].start_ns;
+
+      if(pauses[j-1].start_ns + pauses[j-1].duration_ns > b)
+	sum -= pauses[j-1].start_ns + pauses[j-1].duration_ns - b;
+
+      return sum;
+    };
+
+    // the busiest window starts at a pause or ends at one.
+    std::uint64_t worst = 0;
+
+    for(const pause_event& p : pauses) {
+      std::uint64_t a = std::max(begin_ns, std::min(p.start_ns, end_ns - window_ns));
+      std::uint64_t e = std::min(end_ns, std::max(p.start_ns + p.duration_ns, begin_ns + window_ns));
+
+      worst = std::max(worst, paused(a, a + window_ns));
+      worst = std::max(worst, paused(e - window_ns, e));
+    }
+
+    return 1.0 - static_cast<double>(std::min(worst, window_ns)) / window_ns;
+  }
+}
+#endif
@@ -0,0 +1,120 @@
+#ifndef SCAVENGER_HPP_INCLUDED
+#define SCAVENGER_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "atomic_list.hpp"
+#include "free_span_list.hpp"
+#include "impl_details.hpp"
+#include "stub_list.hpp"
+
+namespace otf_gc
+{
+  class scavenger
+  {
+  private:
+    const std::size_t page_size;
+    std::atomic<std::size_t> retained_target, rate_limit;
+
+    inline std::uint64_t page_floor(std::uint64_t p) const
+    {
+      return p & ~static_cast<std::uint64_t>(page_size - 1);
+    }
+
+    inline std::uint64_t page_ceil(std::uint64_t p) const
+    {
+      return page_floor(p + page_size - 1);
+    }
+
+    inline std::size_t releasable(stub* st) const
+    {
+      auto start = page_ceil(reinterpret_cast<std::uint64_t>(st->start));
+      auto end = page_floor(reinterpret_cast<std::uint64_t>(st->start) + st->size);
+
+      return end > start ? end - start : 0;
+    }
+
+    inline void release(stub* st) const
+    {
+      auto start = page_ceil(reinterpret_cast<std::uint64_t>(st->start));
+      auto end = page_floor(reinterpret_cast<std::uint64_t>(st->start) + st->size);
+
+      madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+    }
+  public:
+    scavenger()
+      : page_size(static_cast<std::size_t>(sysconf(_SC_PAGESIZE)))
+      , retained_target(impl_details::default_retained_memory_target)
+      , rate_limit(impl_details::default_scavenge_rate_limit)
+    {}
+
+    inline void set_retained_target(std::size_t bytes)
+    {
+      retained_target.store(bytes, std::memory_order_relaxed);
+    }
+
+    inline void set_rate_limit(std::size_t bytes)
+    {
+      rate_limit.store(bytes, std::memory_order_relaxed);
+    }
+
+    std::size_t free_bytes(const free_span_list& free_list) const
+    {
+      return free_list.bytes();
+    }
+
+    std::size_t quota(std::size_t free_bytes) const
+    {
+      std::size_t target = retained_target.load(std::memory_order_relaxed);
+
+      if(free_bytes <= target)
+	return 0;
+
+      return std::min(free_bytes - target, rate_limit.load(std::memory_order_relaxed));
+    }
+
+    void scavenge(free_span_list& free_list,
+		  atomic_list<stub_list>& released_list,
+		  std::size_t& quota) const
+    {
+      stub_list sl, released;
+      std::vector<stub_list> kept_runs;
+
+      while(quota > 0 && (sl = free_list.pop_front()))
+      {
+	stub_list kept;
+
+	while(sl) {
+	  stub* st = sl.node_pop_front();
+	  std::size_t bytes = releasable(st);
+
+	  if(quota > 0 && bytes > 0) {
+	    release(st);
+	    released.push_front(st);
+	    quota -= std::min(quota, bytes);
+	  } else {
+	    kept.push_back(st);
+	  }
+	}
+
+	if(kept)
+	  kept_runs.push_back(kept);
+      }
+
+      // republish what is kept run by run, in its original order.
+      for(auto it = kept_runs.rbegin(); it != kept_runs.rend(); ++it)
+	free_list.push_front(*it);
+
+      if(released)
+	released_list.push_front(released);
+    }
+  };
+}
+#endif
@@ -0,0 +1,90 @@
+#ifndef SCRATCH_ARENA_HPP_INCLUDED
+#define SCRATCH_ARENA_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "impl_details.hpp"
+
+namespace otf_gc
+{
+  class scratch_arena
+  {
+  private:
+    static constexpr std::size_t alignment = alignof(std::max_align_t);
+
+    struct overflow_block
+    {
+      overflow_block* next;
+      alignas(alignment) char data[1];
+    };
+
+    char* base;
+    std::size_t offset, capacity;
+    overflow_block* overflow;
+
+    static inline std::size_t align_up(std::size_t sz)
+    {
+      return (sz + alignment - 1) & ~(alignment - 1);
+    }
+
+    OTF_GC_NOINLINE void* allocate_overflow(std::size_t sz)
+    {
+      void* blk = aligned_alloc(alignof(overflow_block),
+				align_up(offsetof(overflow_block, data) + sz));
+      overflow_block* ob = reinterpret_cast<overflow_block*>(blk);
+
+      ob->next = overflow;
+      overflow = ob;
+
+      return ob->data;
+    }
+  public:
+    scratch_arena(std::size_t capacity_ = impl_details::scratch_arena_size)
+      : base(reinterpret_cast<char*>(aligned_alloc(alignment, align_up(capacity_))))
+      , offset(0)
+      , capacity(align_up(capacity_))
+      , overflow(nullptr)
+    {}
+
+    scratch_arena(const scratch_arena&) = delete;
+    scratch_arena& operator=(const scratch_arena&) = delete;
+
+    ~scratch_arena()
+    {
+      reset();
+      free(base);
+    }
+
+    inline std::size_t available() const
+    {
+      return capacity - offset;
+    }
+
+    OTF_GC_ALWAYS_INLINE void* allocate(std::size_t sz)
+    {
+      sz = align_up(sz);
+
+      if(OTF_GC_LIKELY(sz <= capacity - offset)) {
+	void* p = base + offset;
+	offset += sz;
+	return p;
+      }
+
+      return allocate_overflow(sz);
+    }
+
+    inline void reset()
+    {
+      offset = 0;
+
+      while(overflow) {
+	overflow_block* next = overflow->next;
+	free(overflow);
+	overflow = next;
+      }
+    }
+  };
+}
+#endif
@@ -0,0 +1,89 @@
+#ifndef SNOOP_BUFFER_HPP_INCLUDED
+#define SNOOP_BUFFER_HPP_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "impl_details.hpp"
+#include "store_buffer.hpp"
+
+namespace otf_gc
+{
+  class snoop_buffer
+  {
+  private:
+    store_buffer_chunk* head;
+    store_buffer_chunk* tail;
+    void* filter[impl_details::snoop_filter_size];
+
+    OTF_GC_NOINLINE void push_chunk()
+    {
+      store_buffer_chunk* c = store_buffer_chunk::create(impl_details::snoop_buffer_chunk_size);
+
+      c->next = head;
+      head = c;
+
+      if(!tail)
+	tail = c;
+    }
+
+    inline void reset_filter()
+    {
+      for(std::size_t i = 0; i < impl_details::snoop_filter_size; ++i)
+	filter[i] = nullptr;
+    }
+  public:
+    snoop_buffer() : head(nullptr), tail(nullptr)
+    {
+      reset_filter();
+    }
+
+    snoop_buffer(const snoop_buffer&) = delete;
+    snoop_buffer& operator=(const snoop_buffer&) = delete;
+
+    ~snoop_buffer()
+    {
+      clear();
+    }
+
+    OTF_GC_ALWAYS_INLINE void push(void* p)
+    {
+      std::size_t i = (reinterpret_cast<std::uintptr_t>(p) >> 4) & (impl_details::snoop_filter_size - 1);
+
+      if(filter[i] == p)
+	return;
+
+      filter[i] = p;
+
+      if(OTF_GC_UNLIKELY(!head || head->used == head->capacity))
+	push_chunk();
+
+      head->slots[head->used++] = p;
+    }
+
+    void clear()
+    {
+      while(head) {
+	store_buffer_chunk* next = head->next;
+	store_buffer_chunk::destroy(head);
+	head = next;
+      }
+
+      tail = nullptr;
+      reset_filter();
+    }
+
+    void atomic_vacate_and_append(std::atomic<store_buffer_chunk*>& chain)
+    {
+      reset_filter();
+
+      if(!head)
+	return;
+
+      store_buffer_chunk::atomic_append(head, tail, chain);
+      head = tail = nullptr;
+    }
+  };
+}
+#endif
@@ -0,0 +1,167 @@
+#ifndef STORE_BUFFER_HPP_INCLUDED
+#define STORE_BUFFER_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "impl_details.hpp"
+
+namespace otf_gc
+{
+  struct store_buffer_chunk
+  {
+    store_buffer_chunk* next;
+    std::size_t used, capacity;
+    void* slots[1];
+
+    static store_buffer_chunk* create(std::size_t capacity)
+    {
+      void* blk = malloc(offsetof(store_buffer_chunk, slots) + capacity * sizeof(void*));
+      store_buffer_chunk* c = reinterpret_cast<store_buffer_chunk*>(blk);
+
+      c->next = nullptr;
+      c->used = 0;
+      c->capacity = capacity;
+
+      return c;
+    }
+
+    static inline void destroy(store_buffer_chunk* c)
+    {
+      free(reinterpret_cast<void*>(c));
+    }
+
+    static void atomic_append(store_buffer_chunk* head,
+			      store_buffer_chunk* tail,
+			      std::atomic<store_buffer_chunk*>& chain)
+    {
+      tail->next = chain.load(std::memory_order_relaxed);
+
+      while(!chain.compare_exchange_weak(tail->next, head,
+					 std::memory_order_release,
+					 std::memory_order_relaxed));
+    }
+  };
+
+  // a record is [parent | 1][count][children...], never split across chunks.
+  class store_buffer
+  {
+  private:
+    store_buffer_chunk* head;
+    store_buffer_chunk* tail;
+    std::size_t record_start;
+
+    void push_chunk(store_buffer_chunk* c)
+    {
+      c->next = head;
+      head = c;
+
+      if(!tail)
+	tail = c;
+    }
+
+    OTF_GC_NOINLINE void grow_record()
+    {
+      std::size_t len = head->used - record_start;
+      store_buffer_chunk* c =
+	store_buffer_chunk::create(std::max(impl_details::store_buffer_chunk_size, 2 * len));
+
+      memcpy(c->slots, head->slots + record_start, len * sizeof(void*));
+      c->used = len;
+
+      if(record_start == 0) {
+	store_buffer_chunk* empty = head;
+
+	head = head->next;
+
+	if(tail == empty)
+	  tail = head;
+
+	store_buffer_chunk::destroy(empty);
+      } else {
+	head->used = record_start;
+      }
+
+      push_chunk(c);
+      record_start = 0;
+    }
+  public:
+    store_buffer() noexcept : head(nullptr), tail(nullptr), record_start(0) {}
+
+    static inline void* record_parent(void** rec)
+    {
+      return reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(rec[0]) ^ 1ULL);
+    }
+
+    static inline std::size_t record_count(void** rec)
+    {
+      return reinterpret_cast<std::uintptr_t>(rec[1]);
+    }
+
+    static inline void** record_children(void** rec)
+    {
+      return rec + 2;
+    }
+
+    static inline std::size_t record_size(void** rec)
+    {
+      return 2 + record_count(rec);
+    }
+
+    inline bool empty() const
+    {
+      return head == nullptr;
+    }
+
+    inline void begin_record(void* parent)
+    {
+      if(!head || head->capacity - head->used < 2)
+	push_chunk(store_buffer_chunk::create(impl_details::store_buffer_chunk_size));
+
+      record_start = head->used;
+
+      head->slots[head->used++] = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(parent) | 1ULL);
+      head->slots[head->used++] = nullptr;
+    }
+
+    OTF_GC_ALWAYS_INLINE void push(void* p)
+    {
+      if(OTF_GC_UNLIKELY(head->used == head->capacity))
+	grow_record();
+
+      head->slots[head->used++] = p;
+    }
+
+    inline bool record_empty() const
+    {
+      return head->used == record_start + 2;
+    }
+
+    inline void abandon_record()
+    {
+      head->used = record_start;
+    }
+
+    inline void** commit_record()
+    {
+      void** rec = head->slots + record_start;
+      rec[1] = reinterpret_cast<void*>(head->used - record_start - 2);
+
+      return rec;
+    }
+
+    void atomic_vacate_and_append(std::atomic<store_buffer_chunk*>& chain)
+    {
+      if(!head)
+	return;
+
+      store_buffer_chunk::atomic_append(head, tail, chain);
+      head = tail = nullptr;
+    }
+  };
+}
+#endif
@@ -176,6 +176,16 @@ namespace otf_gc
     {
       return head == nullptr;
     }
+
+    inline std::size_t bytes() const
+    {
+      std::size_t sz = 0;
+
+      for(stub* st = head; st; st = st->next)
+	sz += st->size;
+
+      return sz;
+    }
   };
 
   static node_pool<stub_list>& stub_list_pool()
@@ -0,0 +1,149 @@
+#ifndef TRACER_ADAPTER_HPP_INCLUDED
+#define TRACER_ADAPTER_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
+
+#include "atomic_list.hpp"
+#include "impl_details.hpp"
+#include "mark_stack.hpp"
+#include "scratch_arena.hpp"
+
+namespace otf_gc
+{
+  template <class Tracer, class = void>
+  struct has_visitor_interface : std::false_type {};
+
+  template <class Tracer>
+  struct has_visitor_interface<Tracer,
+			       decltype(Tracer::visit_obj(impl_details::underlying_header_t(),
+							  std::declval<void*>(),
+							  std::declval<mark_stack&>()),
+					Tracer::visit_segment(impl_details::underlying_header_t(),
+							      std::declval<void*>(),
+							      std::size_t(),
+							      std::declval<mark_stack&>()),
+					void())>
+    : std::true_type {};
+
+  template <class Tracer, class = void>
+  struct has_scratch_interface : std::false_type {};
+
+  template <class Tracer>
+  struct has_scratch_interface<Tracer,
+			       decltype(Tracer::copy_obj(impl_details::underlying_header_t(),
+							 std::declval<void*>(),
+							 std::declval<scratch_arena&>()),
+					Tracer::copy_obj_segment(impl_details::underlying_header_t(),
+								 std::declval<void*>(),
+								 std::size_t(),
+								 std::declval<scratch_arena&>()),
+					void())>
+    : std::true_type {};
+
+  template <class Tracer, class = void>
+  struct has_size_interface : std::false_type {};
+
+  template <class Tracer>
+  struct has_size_interface<Tracer,
+			    decltype(Tracer::object_size(impl_details::underlying_header_t()),
+				     void())>
+    : std::true_type {};
+
+  // object_size is optional; without it, marked bytes go uncounted.
+  template <class Tracer, bool = has_size_interface<Tracer>::value>
+  struct object_sizer
+  {
+    static inline std::size_t size(impl_details::underlying_header_t h)
+    {
+      return Tracer::object_size(h);
+    }
+  };
+
+  template <class Tracer>
+  struct object_sizer<Tracer, false>
+  {
+    static inline std::size_t size(impl_details::underlying_header_t)
+    {
+      return 0;
+    }
+  };
+
+  template <class Tracer, bool = has_scratch_interface<Tracer>::value>
+  struct snapshot_copier
+  {
+    static inline void* copy_obj(impl_details::underlying_header_t h, void* root, scratch_arena& scratch)
+    {
+      return Tracer::copy_obj(h, root, scratch);
+    }
+
+    static inline void* copy_obj_segment(impl_details::underlying_header_t h, void* root, std::size_t seg, scratch_arena& scratch)
+    {
+      return Tracer::copy_obj_segment(h, root, seg, scratch);
+    }
+
+    static inline void release(void*, scratch_arena& scratch)
+    {
+      scratch.reset();
+    }
+  };
+
+  template <class Tracer>
+  struct snapshot_copier<Tracer, false>
+  {
+    static inline void* copy_obj(impl_details::underlying_header_t h, void* root, scratch_arena&)
+    {
+      return Tracer::copy_obj(h, root);
+    }
+
+    static inline void* copy_obj_segment(impl_details::underlying_header_t h, void* root, std::size_t seg, scratch_arena&)
+    {
+      return Tracer::copy_obj_segment(h, root, seg);
+    }
+
+    static inline void release(void* buf, scratch_arena&)
+    {
+      using namespace impl_details;
+
+      if(!buf) return;
+
+      header_t* hp = reinterpret_cast<header_t*>(reinterpret_cast<std::ptrdiff_t>(buf) - header_size);
+      hp->~header_t();
+
+      free(reinterpret_cast<void*>(hp));
+    }
+  };
+
+  template <class Tracer>
+  struct list_tracer_adapter : Tracer
+  {
+    template <class Visitor>
+    static inline void visit_list(list<void*>&& ptrs, Visitor& v)
+    {
+      while(!ptrs.empty()) {
+	v.push(ptrs.front());
+	ptrs.pop_front();
+      }
+    }
+
+    template <class Visitor>
+    static inline void visit_obj(impl_details::underlying_header_t h, void* buf, Visitor& v)
+    {
+      visit_list(Tracer::get_derived_ptrs(h, buf), v);
+    }
+
+    template <class Visitor>
+    static inline void visit_segment(impl_details::underlying_header_t h, void* buf, std::size_t seg, Visitor& v)
+    {
+      visit_list(Tracer::derived_ptrs_of_obj_segment(h, buf, seg), v);
+    }
+  };
+
+  template <class Tracer>
+  using visiting_tracer = typename std::conditional<has_visitor_interface<Tracer>::value,
+						    Tracer,
+						    list_tracer_adapter<Tracer>>::type;
+}
+#endif
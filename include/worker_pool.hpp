@@ -0,0 +1,120 @@
+#ifndef WORKER_POOL_HPP_INCLUDED
+#define WORKER_POOL_HPP_INCLUDED
+
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace otf_gc
+{
+  class worker_pool
+  {
+  private:
+    std::vector<std::thread> helpers;
+
+    std::mutex mut;
+    std::condition_variable work_cv, done_cv;
+
+    std::function<void(std::size_t)> task;
+    std::size_t generation, pending;
+    bool stopping;
+
+    void helper_loop(std::size_t id, std::size_t seen, std::function<void()> on_exit)
+    {
+      while(true)
+      {
+	std::function<void(std::size_t)> t;
+
+	{
+	  std::unique_lock<std::mutex> lk(mut);
+	  work_cv.wait(lk, [&]() { return stopping || generation != seen; });
+
+	  if(stopping)
+	    break;
+
+	  seen = generation;
+	  t = task;
+	}
+
+	t(id);
+
+	std::lock_guard<std::mutex> lk(mut);
+
+	if(--pending == 0)
+	  done_cv.notify_one();
+      }
+
+      on_exit();
+    }
+  public:
+    worker_pool()
+      : generation(0)
+      , pending(0)
+      , stopping(false)
+    {}
+
+    ~worker_pool()
+    {
+      stop();
+    }
+
+    inline std::size_t size() const
+    {
+      return helpers.size() + 1;
+    }
+
+    void start(std::size_t n, std::function<void()> on_exit)
+    {
+      assert(helpers.empty());
+      stopping = false;
+
+      for(std::size_t i = 1; i < n; ++i)
+	helpers.emplace_back([this, i, on_exit, gen = generation]() {
+	    helper_loop(i, gen, on_exit);
+	  });
+    }
+
+    void stop()
+    {
+      {
+	std::lock_guard<std::mutex> lk(mut);
+	stopping = true;
+      }
+
+      work_cv.notify_all();
+
+      for(auto& t : helpers)
+	t.join();
+
+      helpers.clear();
+    }
+
+    template <class F>
+    void run(F&& f)
+    {
+      if(helpers.empty()) {
+	f(0);
+	return;
+      }
+
+      {
+	std::lock_guard<std::mutex> lk(mut);
+	task = f;
+	pending = helpers.size();
+	++generation;
+      }
+
+      work_cv.notify_all();
+
+      f(0);
+
+      std::unique_lock<std::mutex> lk(mut);
+      done_cv.wait(lk, [&]() { return pending == 0; });
+    }
+  };
+}
+#endif
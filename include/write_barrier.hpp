@@ -2,11 +2,14 @@
 #define WRITE_BARRIER_HPP_INCLUDED
 
 #include <atomic>
+#include <cstring>
 #include <memory>
 
 #include "color.hpp"
 #include "impl_details.hpp"
 #include "gc.hpp"
+#include "store_buffer.hpp"
+#include "tracer_adapter.hpp"
 
 namespace otf_gc
 {
@@ -14,36 +17,83 @@ namespace otf_gc
   class otf_write_barrier_impl
   {
   protected:
-    void prelude(void* parent, T data)
+    static void log_segments(gc::registered_mutator& mut, void* parent, const void* first_field, const void* last_field)
     {
       using namespace impl_details;
-      
-      if(parent && Alloc()->tracing()) {
+
+      if(parent && mut.tracing()) {
 	auto hp = reinterpret_cast<std::ptrdiff_t>(parent) - header_size;
 	auto h  = reinterpret_cast<header_t*>(hp)->load(std::memory_order_relaxed);
-	
-	if(color(h & header_color_mask) != Alloc()->mut_color())
+
+	if(color(h & header_color_mask) != mut.mut_color())
 	{
-	  size_t seg_num =
-	    (reinterpret_cast<std::ptrdiff_t>(&data) - reinterpret_cast<std::ptrdiff_t>(parent)) / segment_size;
-	  
-	  log_ptr_t* lp = Tracer::log_ptr(h, parent, seg_num);
-	  assert(lp != nullptr);
-	  
-	  if(!lp->load()) {
-	    list<void*> temp_buf = Tracer::derived_ptrs_of_obj_segment(h, parent, seg_num);
-	    	    
-	    if(!temp_buf.empty() && !lp->load()) {
-		Alloc()->append_front_buffer(std::move(temp_buf));
-		assert((reinterpret_cast<std::ptrdiff_t>(parent) & 1ULL) == 0ULL);
-		Alloc()->push_front_buffer(reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(parent) | 1ULL));
-
-		lp->store(Alloc()->buffer_ptr());
+	  std::size_t first_seg = segment_of(h, parent, first_field);
+	  std::size_t last_seg = segment_of(h, parent, last_field);
+
+	  for(size_t seg_num = first_seg; seg_num <= last_seg; ++seg_num)
+	  {
+	    log_ptr_t* lp = Tracer::log_ptr(h, parent, seg_num);
+	    assert(lp != nullptr);
+
+	    if(!lp->load()) {
+	      pause_timer timer(mut.pauses(), mut.pauses().histograms.barrier);
+	      store_buffer& buf = mut.log_buffer();
+
+	      assert((reinterpret_cast<std::ptrdiff_t>(parent) & 1ULL) == 0ULL);
+	      buf.begin_record(parent);
+
+	      visiting_tracer<Tracer>::visit_segment(h, parent, seg_num, buf);
+
+	      if(!buf.record_empty() && !lp->load())
+		lp->store(buf.commit_record());
+	      else
+		buf.abandon_record();
 	    }
 	  }
 	}
       }
     }
+
+    static inline std::size_t segment_of(impl_details::underlying_header_t h, void* parent, const void* field)
+    {
+      return (reinterpret_cast<std::ptrdiff_t>(field) - reinterpret_cast<std::ptrdiff_t>(parent))
+	>> impl_details::segment_shift(h);
+    }
+
+    static inline void prelude(gc::registered_mutator& mut, void* parent, const void* field)
+    {
+      log_segments(mut, parent, field, field);
+    }
+
+    static inline void postlude(gc::registered_mutator& mut)
+    {
+      if(OTF_GC_UNLIKELY(mut.sync_requested()))
+	mut.safepoint();
+    }
+
+    template <class U>
+    static inline void snoop(gc::registered_mutator& mut, U* p)
+    {
+      if(mut.snooping() && p)
+	mut.push_snooping(p->derived_ptr());
+    }
+
+    template <class U>
+    static void range_prelude(gc::registered_mutator& mut,
+			      void* parent,
+			      const void* dst_begin,
+			      U* const* src_begin,
+			      std::size_t n)
+    {
+      if(n == 0)
+	return;
+
+      log_segments(mut, parent, dst_begin, reinterpret_cast<const char*>(dst_begin) + n * sizeof(U*) - 1);
+
+      if(mut.snooping())
+	for(std::size_t i = 0; i < n; ++i)
+	  snoop(mut, src_begin[i]);
+    }
   };
   
   template <std::unique_ptr<gc::registered_mutator>&(*)(), class, class>
@@ -55,7 +105,10 @@ namespace otf_gc
   private:
     T* data;
 
-    using otf_write_barrier_impl<Alloc, Tracer, T*>::prelude;    
+    using otf_write_barrier_impl<Alloc, Tracer, T*>::prelude;
+    using otf_write_barrier_impl<Alloc, Tracer, T*>::range_prelude;
+    using otf_write_barrier_impl<Alloc, Tracer, T*>::snoop;
+    using otf_write_barrier_impl<Alloc, Tracer, T*>::postlude;
   public:
     template <typename... Ts>
     otf_write_barrier(Ts&&... items) : data(std::forward<Ts>(items)...)
@@ -72,19 +125,62 @@ namespace otf_gc
     }
 
     otf_write_barrier<Alloc, Tracer, T*>& operator=(T*) = delete;
-  
-    inline void write(void* parent, T* data_)
+
+    OTF_GC_ALWAYS_INLINE void write(gc::registered_mutator& mut, void* parent, T* data_)
     {
-      prelude(parent, data);
-      
+      if(OTF_GC_LIKELY(!mut.barrier_active())) {
+	data = data_;
+	return;
+      }
+
+      prelude(mut, parent, &data);
+
       data = data_;
-      if(Alloc()->snooping() && data)
-	Alloc()->push_front_snooping(data->derived_ptr());
+      snoop(mut, data);
+      postlude(mut);
+    }
+
+    inline void write(void* parent, T* data_)
+    {
+      write(*Alloc(), parent, data_);
     }
   
     inline T* get() {
       return data;
     }
+
+    static void write_range(gc::registered_mutator& mut,
+			    void* parent,
+			    otf_write_barrier* dst_begin,
+			    T* const* src_begin,
+			    std::size_t n)
+    {
+      bool barrier_active = mut.barrier_active();
+
+      if(barrier_active)
+	range_prelude(mut, parent, dst_begin, src_begin, n);
+
+      memmove(reinterpret_cast<void*>(dst_begin), src_begin, n * sizeof(T*));
+
+      if(barrier_active)
+	postlude(mut);
+    }
+
+    static void write_range(gc::registered_mutator& mut,
+			    void* parent,
+			    otf_write_barrier* dst_begin,
+			    const otf_write_barrier* src_begin,
+			    std::size_t n)
+    {
+      static_assert(sizeof(otf_write_barrier) == sizeof(T*), "barrier must have the layout of T*.");
+      write_range(mut, parent, dst_begin, reinterpret_cast<T* const*>(src_begin), n);
+    }
+
+    template <class Src>
+    static inline void write_range(void* parent, otf_write_barrier* dst_begin, Src src_begin, std::size_t n)
+    {
+      write_range(*Alloc(), parent, dst_begin, src_begin, n);
+    }
   
     inline T* const operator->() const
     {
@@ -109,6 +205,9 @@ namespace otf_gc
     std::atomic<T*> data;
 
     using otf_write_barrier_impl<Alloc, Tracer, std::atomic<T*>&>::prelude;
+    using otf_write_barrier_impl<Alloc, Tracer, std::atomic<T*>&>::range_prelude;
+    using otf_write_barrier_impl<Alloc, Tracer, std::atomic<T*>&>::snoop;
+    using otf_write_barrier_impl<Alloc, Tracer, std::atomic<T*>&>::postlude;
   public:
     otf_write_barrier(T* data_) : data(data_) {}
 
@@ -122,13 +221,76 @@ namespace otf_gc
       return data.load(mem);
     }
 
-    inline void store(void* parent, T* val, std::memory_order mem)
+    static void write_range(gc::registered_mutator& mut,
+			    void* parent,
+			    otf_write_barrier* dst_begin,
+			    T* const* src_begin,
+			    std::size_t n,
+			    std::memory_order mem = std::memory_order_relaxed)
+    {
+      bool barrier_active = mut.barrier_active();
+
+      if(barrier_active)
+	range_prelude(mut, parent, dst_begin, src_begin, n);
+
+      if(reinterpret_cast<const void*>(dst_begin) <= reinterpret_cast<const void*>(src_begin))
+	for(std::size_t i = 0; i < n; ++i)
+	  dst_begin[i].data.store(src_begin[i], mem);
+      else
+	for(std::size_t i = n; i > 0; --i)
+	  dst_begin[i-1].data.store(src_begin[i-1], mem);
+
+      if(barrier_active)
+	postlude(mut);
+    }
+
+    static inline void write_range(void* parent,
+				   otf_write_barrier* dst_begin,
+				   T* const* src_begin,
+				   std::size_t n,
+				   std::memory_order mem = std::memory_order_relaxed)
+    {
+      write_range(*Alloc(), parent, dst_begin, src_begin, n, mem);
+    }
+
+    OTF_GC_ALWAYS_INLINE void store(gc::registered_mutator& mut, void* parent, T* val, std::memory_order mem)
     {
-      prelude(parent, data);
+      if(OTF_GC_LIKELY(!mut.barrier_active())) {
+	data.store(val, mem);
+	return;
+      }
+
+      prelude(mut, parent, &data);
 
       data.store(val, mem);
-      if(Alloc()->snooping() && val) 
-	Alloc()->push_front_snooping(val->derived_ptr());      
+      snoop(mut, val);
+      postlude(mut);
+    }
+
+    inline void store(void* parent, T* val, std::memory_order mem)
+    {
+      store(*Alloc(), parent, val, mem);
+    }
+
+    OTF_GC_ALWAYS_INLINE bool compare_exchange_strong(gc::registered_mutator& mut,
+						      void* parent,
+						      T*& expected,
+						      T* desired,
+						      std::memory_order success,
+						      std::memory_order failure)
+    {
+      if(OTF_GC_LIKELY(!mut.barrier_active()))
+	return data.compare_exchange_strong(expected, desired, success, failure);
+
+      prelude(mut, parent, &data);
+
+      bool result = data.compare_exchange_strong(expected, desired, success, failure);
+
+      if(result)
+	snoop(mut, desired);
+
+      postlude(mut);
+      return result;
     }
 
     inline bool compare_exchange_strong(void* parent,
@@ -137,15 +299,24 @@ namespace otf_gc
 					std::memory_order success,
 					std::memory_order failure)
     {
-      prelude(parent, data);
-      
-      bool result = data.compare_exchange_strong(expected, desired, success, failure);
-      
-      if(result && desired && Alloc()->snooping())
-	Alloc()->push_front_snooping(desired->derived_ptr());
-    
-      return result;
+      return compare_exchange_strong(*Alloc(), parent, expected, desired, success, failure);
     }
   };
+
+  template <std::unique_ptr<gc::registered_mutator>&(*Alloc)(), class Tracer, class T, class Src>
+  inline void write_range(void* parent, otf_write_barrier<Alloc, Tracer, T>* dst_begin, Src src_begin, std::size_t n)
+  {
+    otf_write_barrier<Alloc, Tracer, T>::write_range(parent, dst_begin, src_begin, n);
+  }
+
+  template <std::unique_ptr<gc::registered_mutator>&(*Alloc)(), class Tracer, class T, class Src>
+  inline void write_range(gc::registered_mutator& mut,
+			  void* parent,
+			  otf_write_barrier<Alloc, Tracer, T>* dst_begin,
+			  Src src_begin,
+			  std::size_t n)
+  {
+    otf_write_barrier<Alloc, Tracer, T>::write_range(mut, parent, dst_begin, src_begin, n);
+  }
 }
 #endif
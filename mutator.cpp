@@ -3,6 +3,7 @@
 #include <memory>
 
 #include "atomic_list.hpp"
+#include "block_layout.hpp"
 #include "impl_details.hpp"
 #include "gc.hpp"
 #include "mutator.hpp"
@@ -11,90 +12,156 @@ using namespace std;
 
 namespace otf_gc
 {
-  inline size_t mutator::binary_log(int sz)
+  inline void* mutator::get_fixed_block(fixed_list_manager& manager,
+					 free_span_list& collector_free_list,
+					 atomic_list<stub_list>& collector_released_list)
   {
-    assert(sz >= 8);
+    void* ptr = manager.get_block();
 
-    sz--;
-    sz |= sz >> 1;
-    sz |= sz >> 2;
-    sz |= sz >> 4;
-    sz |= sz >> 8;
-    sz |= sz >> 16;
+    if(!ptr) {
+      stub_list stubs = collector_free_list.pop_front();
+
+      if(!stubs)
+	stubs = collector_released_list.pop_front();
 
-    sz -= (sz >> 1) & 0x5555555555555555ULL;
-    sz = (sz & 0x3333333333333333ULL) + ((sz >> 2) & 0x3333333333333333ULL);
-    sz = (sz + (sz >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+      if(stubs) {
+	manager.append(std::move(stubs));
+	ptr = manager.get_block();
+      }
+
+      if(!ptr) {
+	void* blk = manager.get_new_block();
+	allocation_dump.push_front(blk);
+	ptr = blk;
+      }
+    }
 
-    return (sz * 0x0101010101010101ULL) >> 56;
+    return ptr;
+  }
+
+  void mutator::flush_allocation_count()
+  {
+    if(gc::collector->pacing.note_allocation(bytes_allocated))
+      gc::collector->wake_collector();
+
+    bytes_allocated = 0;
   }
 
-  inline impl_details::underlying_header_t
-  mutator::create_header(impl_details::underlying_header_t desc)
+  inline void mutator::count_allocation(std::size_t sz)
+  {
+    bytes_allocated += sz;
+
+    if(bytes_allocated >= impl_details::alloc_flush_bytes)
+      flush_allocation_count();
+  }
+
+  void* mutator::allocate_small_slow(size_t size_class, impl_details::underlying_header_t desc)
   {
     using namespace impl_details;
-    return static_cast<underlying_header_t>(alloc_color.c) | (desc << color_bits);
+
+    if(OTF_GC_UNLIKELY(sync_requested()))
+      safepoint();
+
+    pause_timer timer(pause_rec, pause_rec.histograms.allocation);
+
+    void* ptr = get_fixed_block(fixed_managers[size_class],
+				gc::collector->small_free_lists[size_class],
+				gc::collector->small_released_lists[size_class]);
+
+    small_layout::initialize(reinterpret_cast<std::uint64_t>(ptr), create_header(desc), 1);
+
+    count_allocation(fixed_managers[size_class].release_consumed_bytes());
+
+    return reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(ptr) + small_block_metadata_size);
   }
 
-  inline bool mutator::transfer_small_blocks_from_collector(size_t power)
+  void* mutator::allocate_leaf_small_slow(size_t size_class, impl_details::underlying_header_t desc)
   {
-    stub_list stubs = gc::collector->small_free_lists[power-3].pop_front();
+    using namespace impl_details;
 
-    if(stubs) {
-      fixed_managers[power-3].append(std::move(stubs));
-      return true;
-    }
+    if(OTF_GC_UNLIKELY(sync_requested()))
+      safepoint();
+
+    pause_timer timer(pause_rec, pause_rec.histograms.allocation);
+
+    void* ptr = get_fixed_block(leaf_managers[size_class],
+				gc::collector->leaf_free_lists[size_class],
+				gc::collector->leaf_released_lists[size_class]);
+
+    leaf_layout::initialize(reinterpret_cast<std::uint64_t>(ptr), create_leaf_header(desc), 0);
 
-    return false;
+    count_allocation(leaf_managers[size_class].release_consumed_bytes());
+
+    return reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(ptr) + leaf_block_metadata_size);
   }
 
-  void* mutator::allocate_small(size_t power, impl_details::underlying_header_t desc)
+  void* mutator::allocate_medium(size_t size_class,
+				 impl_details::underlying_header_t h,
+				 size_t num_log_ptrs)
   {
-    void* ptr = fixed_managers[power-3].get_block();
+    using namespace impl_details;
 
-    if(!ptr) {
-      if(transfer_small_blocks_from_collector(power))
-	ptr = fixed_managers[power-3].get_block();
+    void* ptr = get_fixed_block(medium_managers[size_class],
+				gc::collector->medium_free_lists[size_class],
+				gc::collector->medium_released_lists[size_class]);
 
-      if(!ptr) {
-	void* blk = fixed_managers[power-3].get_new_block();
-	allocation_dump.push_front(blk);
-	ptr = blk;
-      }
-    }
+    medium_layout::initialize(reinterpret_cast<std::uint64_t>(ptr), h, num_log_ptrs);
 
-    new(ptr) impl_details::log_ptr_t(nullptr);
-    new(reinterpret_cast<header_t*>(reinterpret_cast<std::ptrdiff_t>(ptr) + log_ptr_size))
-      impl_details::header_t(create_header(desc));
+    count_allocation(medium_managers[size_class].release_consumed_bytes());
 
     return ptr;
   }
 
   void* mutator::allocate_large(size_t sz,
-				impl_details::underlying_header_t desc,
+				impl_details::underlying_header_t h,
 				size_t num_log_ptrs)
   {
     void* blk = aligned_alloc(alignof(impl_details::header_t), sz);
     large_used_list.push_front(blk);
 
     block_cursor blk_c(blk);
-    
+
+    blk_c.size() = sz;
     blk_c.num_log_ptrs() = num_log_ptrs;
     blk_c.recalculate();
 
     for(size_t i = 0; i < num_log_ptrs; ++i)
       new(blk_c.log_ptr(i)) impl_details::log_ptr_t(nullptr);
 
-    new(blk_c.header()) impl_details::header_t(create_header(desc));
+    new(blk_c.header()) impl_details::header_t(h);
+
+    count_allocation(sz);
 
     return blk;
   }
 
+  void mutator::flush_used_spans()
+  {
+    for(auto& m : fixed_managers)
+      m.flush_used_span();
+
+    for(auto& m : leaf_managers)
+      m.flush_used_span();
+
+    for(auto& m : medium_managers)
+      m.flush_used_span();
+  }
+
   stub_list mutator::vacate_small_used_list(size_t i)
   {    
     return fixed_managers[i].release_used_list();
   }
 
+  stub_list mutator::vacate_leaf_used_list(size_t i)
+  {
+    return leaf_managers[i].release_used_list();
+  }
+
+  stub_list mutator::vacate_medium_used_list(size_t i)
+  {
+    return medium_managers[i].release_used_list();
+  }
+
   large_block_list mutator::vacate_large_used_list()
   {
     auto result = large_used_list;
@@ -102,21 +169,54 @@ namespace otf_gc
     return result;
   }
 
-  void* mutator::allocate(int raw_sz,
-			  impl_details::underlying_header_t desc,
-			  size_t num_log_ptrs)
+  void* mutator::allocate_slow(size_t raw_sz,
+			       impl_details::underlying_header_t desc,
+			       size_t num_log_ptrs,
+			       size_t segment_shift)
   {
     using namespace impl_details;
 
-    if(raw_sz + small_block_metadata_size <= large_obj_threshold) {
-      void* p = allocate_small(mutator::binary_log(raw_sz + small_block_metadata_size), desc);
+    if(OTF_GC_UNLIKELY(sync_requested()))
+      safepoint();
+
+    // the write barrier logs the field at offset o in segment
+    // o >> segment_shift, which must have a log pointer.
+    assert(((raw_sz - 1) >> (segment_shift ? segment_shift : default_segment_shift)) < num_log_ptrs);
+
+    pause_timer timer(pause_rec, pause_rec.histograms.allocation);
+
+    if(medium_block_metadata_size + num_log_ptrs * log_ptr_size + raw_sz <= medium_obj_threshold) {
+      size_t preamble_sz = medium_block_metadata_size + num_log_ptrs * log_ptr_size;
+      void* p = allocate_medium(medium_size_class(preamble_sz + raw_sz),
+				create_segmented_header(desc, segment_shift),
+				num_log_ptrs);
 
-      return reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(p) + small_block_metadata_size);
+      return reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(p) + preamble_sz);
     } else {
       size_t preamble_sz = large_block_metadata_size + num_log_ptrs * log_ptr_size;
-      void *p = allocate_large(preamble_sz + raw_sz, desc, num_log_ptrs);
+      void *p = allocate_large(preamble_sz + raw_sz, create_segmented_header(desc, segment_shift), num_log_ptrs);
 
       return reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(p) + preamble_sz);
     }
   }
+
+  void* mutator::allocate_leaf_slow(size_t raw_sz, impl_details::underlying_header_t desc)
+  {
+    using namespace impl_details;
+
+    if(OTF_GC_UNLIKELY(sync_requested()))
+      safepoint();
+
+    pause_timer timer(pause_rec, pause_rec.histograms.allocation);
+
+    if(medium_block_metadata_size + raw_sz <= medium_obj_threshold) {
+      void* p = allocate_medium(medium_size_class(medium_block_metadata_size + raw_sz), create_leaf_header(desc), 0);
+
+      return reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(p) + medium_block_metadata_size);
+    } else {
+      void *p = allocate_large(large_block_metadata_size + raw_sz, create_leaf_header(desc), 0);
+
+      return reinterpret_cast<void*>(reinterpret_cast<std::ptrdiff_t>(p) + large_block_metadata_size);
+    }
+  }
 }
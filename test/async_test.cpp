@@ -0,0 +1,119 @@
+// holds a mutator in an async region, without polling, while the
+// collector runs back to back cycles. they can only complete through the
+// signal-driven handshake, and the region's roots must survive them.
+//
+// build from the repository root with
+//   g++ -std=c++14 -pthread -mcx16 -Iinclude -o async_test
+//       test/async_test.cpp mutator.cpp atomic_list.cpp -latomic
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+
+#include "gc.hpp"
+
+using namespace otf_gc;
+
+std::unique_ptr<gc> gc::collector;
+
+static std::atomic<impl_details::header_t*> root_header(nullptr);
+static std::atomic<bool> root_destroyed(false);
+static std::atomic<std::size_t> cycles(0);
+
+// every object is a pointer-free leaf, so tracing never calls into
+// the Tracer beyond these signatures.
+struct tracer
+{
+  static std::size_t num_log_ptrs(impl_details::underlying_header_t) { return 0; }
+
+  static impl_details::log_ptr_t* log_ptr(impl_details::underlying_header_t, void*, std::size_t)
+  {
+    return nullptr;
+  }
+
+  static void* copy_obj(impl_details::underlying_header_t, void*) { return nullptr; }
+  static void* copy_obj_segment(impl_details::underlying_header_t, void*, std::size_t) { return nullptr; }
+
+  static list<void*> get_derived_ptrs(impl_details::underlying_header_t, void*) { return list<void*>(); }
+
+  static list<void*> derived_ptrs_of_obj_segment(impl_details::underlying_header_t, void*, std::size_t)
+  {
+    return list<void*>();
+  }
+};
+
+struct policy
+{
+  static void destroy(impl_details::underlying_header_t, impl_details::header_t* hp)
+  {
+    if(hp == root_header.load(std::memory_order_relaxed))
+      root_destroyed.store(true, std::memory_order_relaxed);
+  }
+};
+
+static void fail(const char* msg)
+{
+  fprintf(stderr, "async_test: %s\n", msg);
+  exit(1);
+}
+
+int main()
+{
+  const std::size_t garbage = 100000;
+  const std::size_t min_cycles = 5;
+  const std::uint64_t max_wait_ns = 10000000000ULL;
+
+  gc::initialize();
+  gc::collector->set_heap_growth_target(0);
+  gc::collector->set_async_handshake_timeout(200);
+  gc::collector->set_stats_callback([](const gc_stats&) { cycles.fetch_add(1, std::memory_order_relaxed); });
+
+  std::thread collector_thread([]() { gc::collector->run<policy, tracer>(); });
+
+  std::unique_ptr<gc::registered_mutator> mut = gc::create_mutator();
+  void* root = mut->allocate_leaf<32>(0);
+
+  root_header.store(reinterpret_cast<impl_details::header_t*>(static_cast<char*>(root) - impl_details::header_size),
+		    std::memory_order_relaxed);
+  mut->set_root_callback([&root]() { return list<void*>{ root }; });
+
+  for(std::size_t i = 0; i < garbage; ++i)
+    mut->allocate_leaf<32>(0);
+
+  std::size_t start, end;
+  bool swept;
+
+  {
+    void* roots[] = { root };
+    gc::async_region region(*mut, roots, 1);
+
+    start = cycles.load(std::memory_order_relaxed);
+    std::uint64_t deadline = monotonic_ns() + max_wait_ns;
+
+    do {
+      end = cycles.load(std::memory_order_relaxed);
+    } while(end < start + min_cycles && monotonic_ns() < deadline);
+
+    swept = root_destroyed.load(std::memory_order_relaxed);
+  }
+
+  mut.reset();
+  gc::collector->stop();
+  collector_thread.join();
+
+  if(end < start + min_cycles)
+    fail("cycles stalled on a mutator in an async region.");
+
+  if(swept)
+    fail("a root of the async region was swept.");
+
+  printf("async_test: %zu cycles completed inside the async region\n", end - start);
+
+  gc::collector->destroy<policy>();
+
+  return 0;
+}